@@ -0,0 +1,1380 @@
+#include "glm/glm/glm.hpp"
+
+#include "source/loader.h"
+#include "source/cloudfile.h"
+#include "source/reader.h"
+#include "source/progressive.h"
+#include "source/playback.h"
+#include "source/ingest.h"
+#include "source/octree.h"
+#include "source/compactoctree.h"
+#include "source/linearoctree.h"
+#include "source/bounds.h"
+#include "source/slabcache.h"
+#include "source/quantized.h"
+#include "source/hashgrid.h"
+#include "source/voxelsort.h"
+#include "source/voxelfilter.h"
+#include "source/voxelkey.h"
+#include "source/pyramid.h"
+#include "source/rebuild.h"
+#include "source/outlier.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// standalone benchmarks, no GL context needed
+// usage : ./bench load [file]
+//         ./bench formats [points]
+//         ./bench playback [points per frame]
+//         ./bench ingest [points]
+//         ./bench quantize [points]
+//         ./bench downsample [points]
+//         ./bench octree [points]
+//         ./bench linear [points]
+//         ./bench bounds [points]
+//         ./bench box [points]
+//         ./bench slab [points]
+//         ./bench keys [points]
+//         ./bench pyramid [points]
+//         ./bench resize [points]
+//         ./bench outliers [points]
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t fileSize(const std::string& filename)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return 0;
+    return static_cast<size_t>(st.st_size);
+}
+
+// random cloud in a 200m x 20m x 200m box, roughly what the robot produces
+static void makeCloud(size_t count, std::vector<glm::vec3>& vertices)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> xz(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> y(-2.0f, 18.0f);
+    vertices.resize(count);
+    for (auto& v : vertices)
+        v = glm::vec3(xz(rng), y(rng), xz(rng));
+}
+
+static void writeCloud(const std::string& filename, const std::vector<glm::vec3>& vertices)
+{
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (fp == nullptr) {
+        printf("Failed to open file for writing: %s\n", filename.c_str());
+        return;
+    }
+    for (const auto& v : vertices)
+        fprintf(fp, "%f %f %f\n", v.x, v.y, v.z);
+    fclose(fp);
+}
+
+static void benchLoad(std::string filename)
+{
+    if (filename.empty()) {
+        filename = "/tmp/bench_cloud.txt";
+        std::vector<glm::vec3> cloud;
+        makeCloud(2000000, cloud);
+        writeCloud(filename, cloud);
+    }
+    double mb = fileSize(filename) / (1024.0 * 1024.0);
+    printf("file :\t%s (%.1f MB)\n", filename.c_str(), mb);
+
+    std::vector<glm::vec3> a, b;
+
+    double t0 = now();
+    readVerticesStream(filename, a);
+    double t1 = now();
+    readVerticesMapped(filename, b);
+    double t2 = now();
+
+    std::vector<glm::vec3> c;
+    unsigned int threads = loaderThreadCount();
+    double t3 = now();
+    readVerticesParallel(filename, c, threads);
+    double t4 = now();
+
+    printf("getline/istringstream :\t%zu points\t%.3f s\t%.1f MB/s\n", a.size(), t1 - t0, mb / (t1 - t0));
+    printf("mmap parser :\t\t%zu points\t%.3f s\t%.1f MB/s\n", b.size(), t2 - t1, mb / (t2 - t1));
+    printf("mmap parser x%u :\t%zu points\t%.3f s\t%.1f MB/s\n", threads, c.size(), t4 - t3, mb / (t4 - t3));
+
+    if (a.size() != b.size() || b.size() != c.size()) {
+        printf("MISMATCH : point counts differ\n");
+        return;
+    }
+    float maxDiff = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) {
+        glm::vec3 d = glm::abs(a[i] - b[i]);
+        maxDiff = glm::max(maxDiff, glm::max(d.x, glm::max(d.y, d.z)));
+        if (b[i] != c[i]) {
+            printf("MISMATCH : parallel reader differs at point %zu\n", i);
+            return;
+        }
+    }
+    printf("max abs difference :\t%g\n", maxDiff);
+
+    // progressive: how long until the render loop has something to draw
+    std::vector<glm::vec3> e;
+    ProgressiveLoader loader;
+    double t7 = now(), first = 0.0;
+    loader.start(filename);
+    while (!loader.isDone()) {
+        if (loader.poll(e) > 0 && first == 0.0)
+            first = now();
+        std::this_thread::yield();
+    }
+    double t8 = now();
+    printf("progressive :\t\t%zu points\t%.3f s\tfirst chunk after %.2f ms\n", e.size(), t8 - t7, (first - t7) * 1000.0);
+    if (e != b)
+        printf("MISMATCH : progressive loader differs\n");
+
+    std::string binname = "/tmp/bench_cloud.pcld";
+    writeCloudFile(binname, b);
+    std::vector<glm::vec3> d;
+    double t5 = now();
+    readCloudFile(binname, d);
+    double t6 = now();
+    double binmb = fileSize(binname) / (1024.0 * 1024.0);
+    printf(".pcld mmap :\t\t%zu points\t%.3f s\t%.1f MB/s\t(%.1f MB on disk)\n", d.size(), t6 - t5, binmb / (t6 - t5), binmb);
+    if (d != b)
+        printf("MISMATCH : .pcld round trip differs\n");
+}
+
+// binary PCD with an extra intensity field, so x y z are not the whole record
+static void writePCD(const std::string& filename, const std::vector<glm::vec3>& vertices)
+{
+    FILE* fp = fopen(filename.c_str(), "wb");
+    fprintf(fp, "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\nFIELDS x y z intensity\n"
+        "SIZE 4 4 4 4\nTYPE F F F F\nCOUNT 1 1 1 1\nWIDTH %zu\nHEIGHT 1\n"
+        "VIEWPOINT 0 0 0 1 0 0 0\nPOINTS %zu\nDATA binary\n", vertices.size(), vertices.size());
+    for (const auto& v : vertices) {
+        float record[4] = { v.x, v.y, v.z, 1.0f };
+        fwrite(record, sizeof(record), 1, fp);
+    }
+    fclose(fp);
+}
+
+static void writePLY(const std::string& filename, const std::vector<glm::vec3>& vertices)
+{
+    FILE* fp = fopen(filename.c_str(), "wb");
+    fprintf(fp, "ply\nformat binary_little_endian 1.0\nelement vertex %zu\n"
+        "property double x\nproperty double y\nproperty double z\nproperty uchar red\n"
+        "element face 0\nproperty list uchar int vertex_indices\nend_header\n", vertices.size());
+    for (const auto& v : vertices) {
+        double xyz[3] = { v.x, v.y, v.z };
+        unsigned char red = 255;
+        fwrite(xyz, sizeof(xyz), 1, fp);
+        fwrite(&red, 1, 1, fp);
+    }
+    fclose(fp);
+}
+
+static void benchReader(const std::string& label, const std::string& filename, const std::vector<glm::vec3>& expected)
+{
+    double mb = fileSize(filename) / (1024.0 * 1024.0);
+    std::vector<glm::vec3> vertices;
+
+    double t0 = now();
+    PointReader* reader = openPointReader(filename);
+    readVerticesStreamed(*reader, vertices);
+    delete reader;
+    double t1 = now();
+
+    printf("%s :\t%zu points\t%.3f s\t%.1f MB/s\n", label.c_str(), vertices.size(), t1 - t0, mb / (t1 - t0));
+    if (vertices != expected)
+        printf("MISMATCH : %s round trip differs\n", label.c_str());
+}
+
+static void benchFormats(size_t count)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+
+    writePCD("/tmp/bench_cloud.pcd", cloud);
+    writePLY("/tmp/bench_cloud.ply", cloud);
+    benchReader("pcd binary", "/tmp/bench_cloud.pcd", cloud);
+    benchReader("ply binary", "/tmp/bench_cloud.ply", cloud);
+}
+
+// how many frames per second the prefetcher sustains when the consumer never waits on the render side
+static void benchPlayback(size_t count)
+{
+    const int frameCount = 8;
+    std::string dir = "/tmp/bench_frames";
+    mkdir(dir.c_str(), 0755);
+
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    for (int i = 0; i < frameCount; i++) {
+        char name[256];
+        snprintf(name, sizeof(name), "%s/frame_%03d.pcld", dir.c_str(), i);
+        writeCloudFile(name, cloud);
+    }
+
+    FramePlayer player(listFrames(dir));
+    std::vector<glm::vec3> front;
+    player.waitNext(front);
+
+    int shown = 0;
+    double t0 = now();
+    while (shown < 3 * frameCount && player.waitNext(front))
+        shown++;
+    double t1 = now();
+
+    printf("playback :\t%zu points/frame\t%.1f frames/s\n", front.size(), shown / (t1 - t0));
+}
+
+// publisher thread -> socket -> ring -> consumer inserting into an octree, end to end
+static void benchIngest(size_t count)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+
+    SocketIngest ingest("/tmp/bench_ingest.sock");
+    if (!ingest.start())
+        return;
+
+    double t0 = now();
+    std::thread publisher([&]() {
+        int fd = connectSocket(ingest.Path);
+        for (size_t sent = 0; fd >= 0 && sent < cloud.size(); sent += 10000) {
+            uint32_t n = static_cast<uint32_t>(std::min<size_t>(10000, cloud.size() - sent));
+            sendBatch(fd, cloud.data() + sent, n);
+        }
+        close(fd);
+    });
+
+    Octree octree(0.25f, 512.0f);
+    std::vector<glm::vec3> received, incoming;
+    size_t polls = 0;
+    while (received.size() < cloud.size() && now() - t0 < 30.0) {
+        incoming.clear();
+        if (ingest.drain(incoming, 1 << 18) > 0) {
+            for (const auto& p : incoming)
+                octree.insert(octree.getRoot(), p);
+            received.insert(received.end(), incoming.begin(), incoming.end());
+        }
+        polls++;
+    }
+    double t1 = now();
+    publisher.join();
+
+    printf("ingest :\t%zu points\t%.3f s\t%.1f Mpoints/s\t%u leaves\t%zu polls\n",
+        received.size(), t1 - t0, received.size() / (t1 - t0) / 1e6, octree.getLeafCount(), polls);
+    if (received != cloud)
+        printf("MISMATCH : ingested points differ\n");
+
+    // a client that stops halfway through a batch must not keep stop() waiting
+    int stalled = connectSocket(ingest.Path);
+    BatchHeader header;
+    memcpy(header.Magic, BATCH_MAGIC, 4);
+    header.Count = 1000;
+    sendAll(stalled, &header, sizeof(header));
+    sendAll(stalled, cloud.data(), 10 * sizeof(glm::vec3));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    double t2 = now();
+    ingest.stop();
+    double t3 = now();
+    close(stalled);
+    printf("stop with a stalled client :\t%.0f ms\n", (t3 - t2) * 1e3);
+    if (t3 - t2 > 1.0)
+        printf("MISMATCH : stop() waited on a stalled client\n");
+}
+
+static void benchQuantize(size_t count)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+
+    QuantizedCloud q;
+    q.Offsets.reserve(count);
+    double t0 = now();
+    for (size_t i = 0; i < cloud.size(); i += READ_BLOCK_POINTS)
+        q.append(cloud.data() + i, std::min(READ_BLOCK_POINTS, cloud.size() - i));
+    double t1 = now();
+    size_t appended = q.Chunks.size();
+    std::vector<glm::vec3> before;
+    q.decode(before);
+    double t2 = now();
+    q.regroup();
+    double t3 = now();
+
+    // points come back grouped by chunk, so compare the sorted coordinates per axis
+    std::vector<glm::vec3> decoded;
+    q.decode(decoded);
+    auto less = [](const glm::vec3& a, const glm::vec3& b) {
+        return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+    };
+    std::vector<glm::vec3> after(decoded);
+    std::sort(before.begin(), before.end(), less);
+    std::sort(after.begin(), after.end(), less);
+    if (after != before)
+        printf("MISMATCH : regroup changed the points\n");
+    float maxErr = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        std::vector<float> a, b;
+        for (size_t i = 0; i < cloud.size(); i++) {
+            a.push_back(cloud[i][axis]);
+            b.push_back(decoded[i][axis]);
+        }
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        for (size_t i = 0; i < a.size(); i++)
+            maxErr = glm::max(maxErr, std::fabs(a[i] - b[i]));
+    }
+
+    double floatMB = cloud.size() * sizeof(glm::vec3) / 1048576.0;
+    double quantMB = q.memoryBytes() / 1048576.0;
+    printf("quantize :\t%zu points\t%.3f s\t%zu chunks\tmax error %.2f mm\n", q.size(), t1 - t0, appended, maxErr * 1000.0f);
+    printf("regroup :\t%.3f s\t%zu chunks, one per occupied cell\n", t3 - t2, q.Chunks.size());
+    printf("memory :\tfloat %.1f MB\tquantized %.1f MB\t(%.2fx)\n", floatMB, quantMB, floatMB / quantMB);
+
+    // the viewer's octree downsample of a quantized cloud: every decoded point inserted
+    // on its own, against decoded blocks collapsed on all cores and bulk built
+    Octree inserted(0.25f, 512.0f);
+    t0 = now();
+    q.forEach([&inserted](const glm::vec3& p) {
+        inserted.insert(inserted.getRoot(), p);
+    });
+    t1 = now();
+    Octree bulk(0.25f, 512.0f);
+    std::vector<glm::vec3> voxels;
+    ParallelVoxelGrid partial(0.25f);
+    q.forEachBlock([&](const glm::vec3* points, size_t n) {
+        partial.build(points, n);
+        voxels.insert(voxels.end(), partial.Voxels.begin(), partial.Voxels.end());
+    });
+    bulk.build(voxels.data(), voxels.size());
+    t2 = now();
+    std::vector<glm::vec3> a, b;
+    inserted.octreeToVector(inserted.getRoot(), a);
+    bulk.octreeToVector(bulk.getRoot(), b);
+    std::sort(a.begin(), a.end(), less);
+    std::sort(b.begin(), b.end(), less);
+    printf("octree downsample :\tpoint by point %.3f s\tblocks + bulk build %.3f s\t%zu voxels\n", t1 - t0, t2 - t1, b.size());
+    if (a != b)
+        printf("MISMATCH : block downsample differs from point by point\n");
+}
+
+static bool lessVec(const glm::vec3& a, const glm::vec3& b)
+{
+    if (a.x != b.x)
+        return a.x < b.x;
+    if (a.y != b.y)
+        return a.y < b.y;
+    return a.z < b.z;
+}
+
+static void reportDownsample(const char* label, double seconds, size_t points, size_t voxels)
+{
+    printf("%s :\t%zu voxels\t%.3f s\t%.1f Mpoints/s\n", label, voxels, seconds, points / seconds / 1e6);
+}
+
+// every backend puts a point lying exactly on a voxel face in the upper voxel, the
+// floor lattice, so the voxel sets must be identical
+static void compareVoxels(const char* label, std::vector<glm::vec3> voxels, const std::vector<glm::vec3>& sortedReference)
+{
+    std::sort(voxels.begin(), voxels.end(), lessVec);
+    std::vector<glm::vec3> diff;
+    std::set_symmetric_difference(voxels.begin(), voxels.end(), sortedReference.begin(), sortedReference.end(),
+        std::back_inserter(diff), lessVec);
+    if (!diff.empty())
+        printf("MISMATCH : %s differs from the octree in %zu voxels\n", label, diff.size());
+}
+
+// voxelizes the same cloud with every backend and checks they agree on the voxel set
+static void benchDownsample(size_t count)
+{
+    const float voxelSize = 0.25f;
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    printf("points :\t%zu\n", cloud.size());
+
+    Octree octree(voxelSize, 512.0f);
+    double t0 = now();
+    for (const auto& p : cloud)
+        octree.insert(octree.getRoot(), p);
+    double t1 = now();
+    std::vector<glm::vec3> reference;
+    octree.octreeToVector(octree.getRoot(), reference);
+    reportDownsample("octree insert", t1 - t0, cloud.size(), reference.size());
+    std::sort(reference.begin(), reference.end(), lessVec);
+
+    // the same cloud merged as four scans; the reported deltas must add up to the full map
+    Octree scans(voxelSize, 512.0f);
+    std::vector<glm::vec3> deltas;
+    t0 = now();
+    for (size_t scan = 0; scan < 4; scan++) {
+        size_t begin = cloud.size() * scan / 4, end = cloud.size() * (scan + 1) / 4;
+        size_t created = scans.insert(cloud.data() + begin, end - begin, deltas);
+        printf("scan %zu :\t%zu points\t%zu new leaves\n", scan, end - begin, created);
+    }
+    t1 = now();
+    reportDownsample("octree merge", t1 - t0, cloud.size(), deltas.size());
+    std::sort(deltas.begin(), deltas.end(), lessVec);
+    if (deltas != reference)
+        printf("MISMATCH : merged scan deltas differ from a one-shot insert\n");
+
+    VoxelHashGrid grid(voxelSize);
+    t0 = now();
+    grid.insert(cloud.data(), cloud.size());
+    t1 = now();
+    reportDownsample("flat hash grid", t1 - t0, cloud.size(), grid.size());
+    compareVoxels("flat hash grid", grid.Voxels, reference);
+
+    CentroidVoxelFilter filter(voxelSize);
+    t0 = now();
+    filter.insert(cloud.data(), cloud.size());
+    t1 = now();
+    reportDownsample("centroid filter", t1 - t0, cloud.size(), filter.size());
+    // every point lands in exactly one voxel and its centroid stays inside that voxel
+    uint64_t counted = 0;
+    size_t outside = 0;
+    for (size_t i = 0; i < filter.size(); i++) {
+        counted += filter.Counts[i];
+        glm::vec3 d = glm::abs(filter.centroidOf(i) - filter.centreOf(i));
+        if (glm::max(d.x, glm::max(d.y, d.z)) > voxelSize * 0.5f + 1e-4f)
+            outside++;
+    }
+    if (counted != cloud.size() || outside > 0)
+        printf("MISMATCH : centroid filter counted %lu points, %zu centroids outside their voxel\n",
+            static_cast<unsigned long>(counted), outside);
+    std::vector<glm::vec3> centres(filter.size());
+    for (size_t i = 0; i < filter.size(); i++)
+        centres[i] = filter.centreOf(i);
+    compareVoxels("centroid filter", centres, reference);
+
+    ParallelVoxelGrid merged(voxelSize);
+    t0 = now();
+    merged.build(cloud);
+    t1 = now();
+    reportDownsample("parallel partial grids", t1 - t0, cloud.size(), merged.size());
+    compareVoxels("parallel partial grids", merged.Voxels, reference);
+    ParallelVoxelGrid mergedSingle(voxelSize);
+    mergedSingle.build(cloud, 1);
+    ParallelVoxelGrid mergedMany(voxelSize);
+    mergedMany.build(cloud, 7);
+    if (mergedSingle.Keys != merged.Keys || mergedMany.Keys != merged.Keys)
+        printf("MISMATCH : parallel grid voxels depend on the thread count\n");
+
+    MortonVoxelSet sorted(voxelSize);
+    t0 = now();
+    sorted.build(cloud);
+    t1 = now();
+    reportDownsample("morton radix sort", t1 - t0, cloud.size(), sorted.size());
+    compareVoxels("morton radix sort", sorted.Voxels, reference);
+
+    // output must not depend on the thread count
+    MortonVoxelSet single(voxelSize);
+    single.build(cloud, 1);
+    MortonVoxelSet many(voxelSize);
+    many.build(cloud, 7);
+    if (single.Keys != sorted.Keys || many.Keys != sorted.Keys)
+        printf("MISMATCH : morton voxels depend on the thread count\n");
+}
+
+static void insertAll(Octree& octree, const std::vector<glm::vec3>& points)
+{
+    for (const auto& p : points)
+        octree.insert(octree.getRoot(), p);
+}
+
+// octree builds from scratch and after clear(); the arena must give all memory back
+// with the tree and reuse its blocks after a clear
+static void benchOctree(size_t count)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    printf("points :\t%zu\tresident %.1f MB\n", cloud.size(), residentBytes("VmRSS:") / 1048576.0);
+
+    std::vector<glm::vec3> reference;
+    for (int build = 0; build < 3; build++) {
+        size_t before = residentBytes("VmRSS:");
+        Octree* octree = new Octree(0.25f, 512.0f);
+        double t0 = now();
+        for (const auto& p : cloud)
+            octree->insert(octree->getRoot(), p);
+        double t1 = now();
+        printf("fresh build %d :\t%.3f s\t%.1f Mpoints/s\t%zu nodes\t%u leaves\t%.1f MB arena\n",
+            build, t1 - t0, cloud.size() / (t1 - t0) / 1e6, octree->getNodeCount(), octree->getLeafCount(),
+            octree->memoryBytes() / 1048576.0);
+        if (build == 0)
+            octree->octreeToVector(octree->getRoot(), reference);
+        delete octree;
+        size_t after = residentBytes("VmRSS:");
+        printf("fresh build %d :\t%.1f MB resident left after delete\n", build,
+            after > before ? (after - before) / 1048576.0 : 0.0);
+    }
+
+    // recursive float descent against the integer one, on the cloud plus points lying
+    // exactly on voxel faces, where the two could disagree about the side
+    std::vector<glm::vec3> faces(cloud.begin(), cloud.begin() + std::min<size_t>(cloud.size(), 100000));
+    for (auto& p : faces)
+        p = glm::round(p * 4.0f) * 0.25f;
+    double seconds[2], warmSeconds[2];
+    std::vector<glm::vec3> leaves[2];
+    for (int path = 0; path < 2; path++) {
+        Octree tree(0.25f, 512.0f);
+        bool created;
+        double t0 = now();
+        if (path == 0) {
+            for (const auto& p : cloud)
+                tree.insertLeaf(tree.getRoot(), p, created);
+        }
+        else {
+            for (const auto& p : cloud)
+                tree.insertPoint(p, created);
+        }
+        seconds[path] = now() - t0;
+        // the same points again, every node exists now: descent only
+        t0 = now();
+        if (path == 0) {
+            for (const auto& p : cloud)
+                tree.insertLeaf(tree.getRoot(), p, created);
+        }
+        else {
+            for (const auto& p : cloud)
+                tree.insertPoint(p, created);
+        }
+        warmSeconds[path] = now() - t0;
+        for (const auto& p : faces) {
+            if (path == 0)
+                tree.insertLeaf(tree.getRoot(), p, created);
+            else
+                tree.insertPoint(p, created);
+        }
+        tree.octreeToVector(tree.getRoot(), leaves[path]);
+    }
+    printf("float recursion :\t%.1f ns per new point\t%.1f ns per existing point\n",
+        seconds[0] / cloud.size() * 1e9, warmSeconds[0] / cloud.size() * 1e9);
+    printf("integer descent :\t%.1f ns per new point\t%.1f ns per existing point\t%.2fx / %.2fx\n",
+        seconds[1] / cloud.size() * 1e9, warmSeconds[1] / cloud.size() * 1e9,
+        seconds[0] / seconds[1], warmSeconds[0] / warmSeconds[1]);
+    if (leaves[0] != leaves[1])
+        printf("MISMATCH : integer descent builds a different tree\n");
+
+    // bulk load from sorted keys against the repeated insert above
+    for (unsigned int threads : { 0u, 1u, 7u }) {
+        Octree bulk(0.25f, 512.0f);
+        double t0 = now();
+        bulk.build(cloud.data(), cloud.size(), threads);
+        double t1 = now();
+        std::vector<glm::vec3> created;
+        bulk.insert(faces.data(), faces.size(), created);
+        std::vector<glm::vec3> bulkLeaves;
+        bulk.octreeToVector(bulk.getRoot(), bulkLeaves);
+        // the per-thread arenas' partly used blocks are filled before new ones are taken
+        printf("bulk build, %u threads :\t%.3f s\t%.1f Mpoints/s\t%zu nodes\t%.1fx insert\t%.1f MB arena, %.1f MB of nodes\n",
+            threads == 0 ? workerCount() : threads, t1 - t0, cloud.size() / (t1 - t0) / 1e6,
+            bulk.getNodeCount(), seconds[1] / (t1 - t0), bulk.memoryBytes() / 1048576.0,
+            bulk.getNodeCount() * sizeof(OctreeNode) / 1048576.0);
+        // the bulk build fits its root to the cloud, so the leaves come out in another order
+        std::vector<glm::vec3> expected(leaves[1]);
+        std::sort(expected.begin(), expected.end(), lessVec);
+        std::sort(bulkLeaves.begin(), bulkLeaves.end(), lessVec);
+        if (bulkLeaves != expected)
+            printf("MISMATCH : bulk build differs from repeated insert\n");
+    }
+
+    Octree octree(0.25f, 512.0f);
+    for (const auto& p : cloud)
+        octree.insert(octree.getRoot(), p);
+    size_t held = octree.memoryBytes();
+    for (int build = 0; build < 3; build++) {
+        double t0 = now();
+        octree.clear();
+        double t1 = now();
+        for (const auto& p : cloud)
+            octree.insert(octree.getRoot(), p);
+        double t2 = now();
+        printf("clear + rebuild %d :\tclear %.6f s\tinsert %.3f s\t%.1f Mpoints/s\t%.1f MB arena\n",
+            build, t1 - t0, t2 - t1, cloud.size() / (t2 - t1) / 1e6, octree.memoryBytes() / 1048576.0);
+    }
+    std::vector<glm::vec3> rebuilt;
+    octree.octreeToVector(octree.getRoot(), rebuilt);
+    if (rebuilt != reference || octree.memoryBytes() != held)
+        printf("MISMATCH : rebuild after clear differs from a fresh tree or grew the arena\n");
+    printf("node size :\t%zu bytes\t%.1f bytes per leaf\n", sizeof(OctreeNode),
+        static_cast<double>(octree.memoryBytes()) / octree.getLeafCount());
+
+    CompactOctree compact;
+    double t0 = now();
+    compact.build(octree);
+    double t1 = now();
+    printf("compact build :\t%.3f s\t%zu nodes\t%.1f MB\t%zu bytes per node\t%.1fx smaller\n",
+        t1 - t0, compact.size(), compact.memoryBytes() / 1048576.0, sizeof(CompactOctreeNode),
+        static_cast<double>(octree.memoryBytes()) / compact.memoryBytes());
+    std::vector<glm::vec3> flattened;
+    compact.toVector(flattened);
+    size_t missing = 0;
+    for (const auto& p : cloud)
+        missing += !compact.contains(p);
+    if (flattened != reference || missing > 0)
+        printf("MISMATCH : compact octree differs from the pointer tree\n");
+    size_t bare = compact.memoryBytes();
+    t0 = now();
+    compact.indexLeaves();
+    t1 = now();
+    printf("leaf index :\t%.3f s\t%.1f MB more\t%.1fx smaller with it\n",
+        t1 - t0, (compact.memoryBytes() - bare) / 1048576.0, static_cast<double>(octree.memoryBytes()) / compact.memoryBytes());
+    if (compact.Leaves != reference)
+        printf("MISMATCH : leaf index differs from the pointer tree\n");
+
+    // the per-frame query, over a sweep of camera heights
+    std::vector<glm::vec3> slab, compactSlab;
+    double pointerSeconds = 0.0, compactSeconds = 0.0;
+    for (float y = -2.0f; y <= 18.0f; y += 0.5f) {
+        slab.clear();
+        compactSlab.clear();
+        t0 = now();
+        octree.findByY(octree.getRoot(), y, slab);
+        t1 = now();
+        compact.findByY(y, compactSlab);
+        double t2 = now();
+        pointerSeconds += t1 - t0;
+        compactSeconds += t2 - t1;
+        if (slab != compactSlab)
+            printf("MISMATCH : compact findByY differs at y = %.1f\n", y);
+    }
+    printf("findByY x41 :\tpointer tree %.3f s\tcompact %.3f s\n", pointerSeconds, compactSeconds);
+
+    // the viewer frees the pointer tree of a static cloud once the copy exists
+    size_t resident = residentBytes("VmRSS:");
+    octree.release();
+    size_t released = residentBytes("VmRSS:");
+    std::vector<glm::vec3> frozen;
+    compact.toVector(frozen);
+    printf("pointer tree released :\t%.1f MB arena left\t%.1f MB resident freed\n",
+        octree.memoryBytes() / 1048576.0, (resident - std::min(resident, released)) / 1048576.0);
+    if (frozen != reference || octree.getLeafCount() != 0)
+        printf("MISMATCH : the compact copy depends on the released tree\n");
+}
+
+// point, parent and neighbour lookups on the hashed linear octree against walks down the
+// compact octree, and the render loop's slab membership test against std::unordered_set
+static void benchLinearOctree(size_t count)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    // on the root's low face, which all three trees hold; the high face is outside
+    cloud.push_back(glm::vec3(-256.0f, 0.1f, -256.0f));
+    const glm::vec3 highFace(256.0f, 0.1f, 0.1f);
+    printf("points :\t%zu\n", cloud.size());
+
+    // inserted rather than bulk built, which would fit the root to the cloud
+    Octree octree(0.25f, 512.0f);
+    insertAll(octree, cloud);
+    CompactOctree compact;
+    compact.build(octree);
+    std::vector<glm::vec3> leaves;
+    compact.toVector(leaves);
+
+    LinearOctree linear(0.25f, 512.0f);
+    double t0 = now();
+    linear.insert(cloud.data(), cloud.size());
+    double t1 = now();
+    printf("linear octree insert :\t%.3f s\t%.1f Mpoints/s\t%zu leaves\t%zu nodes\t%.1f MB\n",
+        t1 - t0, cloud.size() / (t1 - t0) / 1e6, linear.getLeafCount(), linear.size(), linear.memoryBytes() / 1048576.0);
+    size_t wrong = 0;
+    for (const auto& c : leaves)
+        wrong += linear.centreOf(linear.keyOf(c)) != c;
+    if (linear.getLeafCount() != leaves.size() || linear.size() != octree.getNodeCount() || wrong > 0)
+        printf("MISMATCH : linear octree differs from the octree\n");
+
+    size_t found[2] = { 0, 0 };
+    t0 = now();
+    for (const auto& p : cloud)
+        found[0] += compact.contains(p);
+    t1 = now();
+    for (const auto& p : cloud)
+        found[1] += linear.contains(p);
+    double t2 = now();
+    printf("contains, existing :\tcompact walk %.1f ns\tlinear %.1f ns\n",
+        (t1 - t0) / cloud.size() * 1e9, (t2 - t1) / cloud.size() * 1e9);
+    if (found[0] != cloud.size() || found[1] != cloud.size())
+        printf("MISMATCH : a point's leaf is missing\n");
+    uint8_t highFound;
+    linear.contains(&highFace, 1, &highFound);
+    if (Octree::encloses(octree.getRootCentre(), octree.getRootSize(), highFace) || compact.contains(highFace) ||
+        linear.keyOf(highFace) != LINEAROCTREE_NONE || highFound)
+        printf("MISMATCH : a point on the root's high face is inside\n");
+
+    // parent and six face neighbours of every leaf, no walk from the root
+    std::vector<uint64_t> keys(leaves.size());
+    for (size_t i = 0; i < leaves.size(); i++)
+        keys[i] = linear.keyOf(leaves[i]);
+    size_t parents = 0, neighbours = 0;
+    t0 = now();
+    for (uint64_t key : keys) {
+        parents += linear.contains(LinearOctree::parentOf(key));
+        neighbours += linear.contains(linear.neighbourOf(key, -1, 0, 0)) + linear.contains(linear.neighbourOf(key, 1, 0, 0));
+        neighbours += linear.contains(linear.neighbourOf(key, 0, -1, 0)) + linear.contains(linear.neighbourOf(key, 0, 1, 0));
+        neighbours += linear.contains(linear.neighbourOf(key, 0, 0, -1)) + linear.contains(linear.neighbourOf(key, 0, 0, 1));
+    }
+    t1 = now();
+    size_t expected = 0;
+    const glm::vec3 steps[6] = { glm::vec3(-1, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, -1, 0),
+        glm::vec3(0, 1, 0), glm::vec3(0, 0, -1), glm::vec3(0, 0, 1) };
+    for (const auto& c : leaves) {
+        for (const auto& step : steps)
+            expected += compact.contains(c + step * 0.25f);
+    }
+    printf("parent + 6 neighbours :\t%.1f ns per leaf\t%zu neighbours\n", (t1 - t0) / keys.size() * 1e9, neighbours);
+    if (parents != keys.size() || neighbours != expected)
+        printf("MISMATCH : parent or neighbour lookups differ from the octree\n");
+
+    // one frame of the render loop: mark the slab, then test every voxel against it
+    std::vector<glm::vec3> slab;
+    compact.findByY(8.0f, slab);
+    std::vector<uint64_t> slabKeys(slab.size()), voxelKeys(leaves.size());
+    t0 = now();
+    encodeVoxelKeys(slab.data(), slab.size(), 0.25f, slabKeys.data());
+    std::unordered_set<uint64_t> slabSet(slabKeys.begin(), slabKeys.end());
+    encodeVoxelKeys(leaves.data(), leaves.size(), 0.25f, voxelKeys.data());
+    size_t skipped[2] = { 0, 0 };
+    for (uint64_t key : voxelKeys)
+        skipped[0] += slabSet.count(key);
+    t1 = now();
+    LinearOctree slabTree(0.25f, 512.0f);
+    // warm up the table, as the render loop keeps it between frames
+    slabTree.insert(slab.data(), slab.size());
+    t2 = now();
+    slabTree.clear();
+    slabTree.insert(slab.data(), slab.size());
+    std::vector<uint8_t> inSlab(leaves.size());
+    slabTree.contains(leaves.data(), leaves.size(), inSlab.data());
+    for (uint8_t in : inSlab)
+        skipped[1] += in;
+    double t3 = now();
+    printf("slab frame, %zu of %zu :\tunordered_set %.3f s\tlinear octree %.3f s\n",
+        slab.size(), leaves.size(), t1 - t0, t3 - t2);
+    if (skipped[0] != slab.size() || skipped[1] != slab.size())
+        printf("MISMATCH : slab membership differs\n");
+
+    // the same scene 1 km away: a 512 m root around the origin holds none of it, a root
+    // fitted to the slab's bounds marks the same voxels as before
+    const glm::vec3 offset(1000.0f, 300.0f, -700.0f);
+    for (auto& v : slab)
+        v += offset;
+    for (auto& v : leaves)
+        v += offset;
+    glm::vec3 min, max;
+    boundsOf(slab.data(), slab.size(), min, max);
+    slabTree.clear();
+    slabTree.insert(slab.data(), slab.size());
+    size_t origin = slabTree.getLeafCount();
+    slabTree.fit(min, max);
+    slabTree.insert(slab.data(), slab.size());
+    slabTree.contains(leaves.data(), leaves.size(), inSlab.data());
+    size_t far = 0;
+    for (uint8_t in : inSlab)
+        far += in;
+    wrong = 0;
+    for (const auto& v : slab)
+        wrong += slabTree.centreOf(slabTree.keyOf(v)) != v;
+    printf("slab 1 km out :\t%zu of %zu in a 512 m root\t%zu in a fitted %.0f m root\n",
+        origin, slab.size(), far, slabTree.getRootSize());
+    if (origin != 0 || far != slab.size() || wrong > 0)
+        printf("MISMATCH : fitted slab membership differs\n");
+}
+
+// bounding box reduction, an indoor scan in the default 512 m root against a fitted one,
+// and a root that has to grow for points beyond +-256 m
+static void benchBounds(size_t count)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX), lo, hi;
+    double t0 = now();
+    boundsScalar(cloud.data(), cloud.size(), min, max);
+    double t1 = now();
+    boundsOf(cloud.data(), cloud.size(), lo, hi);
+    double t2 = now();
+    printf("bounds, %zu points :\tscalar %.2f ms\tvector + threads %.2f ms\t%.1fx\n",
+        cloud.size(), (t1 - t0) * 1e3, (t2 - t1) * 1e3, (t1 - t0) / (t2 - t1));
+    if (lo != min || hi != max)
+        printf("MISMATCH : bounds differ\n");
+
+    // overflowed and missing coordinates, in vector blocks and in the scalar tail, must
+    // not reach the bounds or the fitted root
+    std::vector<glm::vec3> poisoned(cloud);
+    const float inf = std::numeric_limits<float>::infinity();
+    const float bad[3] = { inf, -inf, std::numeric_limits<float>::quiet_NaN() };
+    for (size_t i = 0; i < 30; i++)
+        poisoned[(i * 7919) % poisoned.size()][i % 3] = bad[i / 3 % 3];
+    poisoned[poisoned.size() - 1] = glm::vec3(inf, -inf, inf);
+    glm::vec3 expectedMin(FLT_MAX), expectedMax(-FLT_MAX);
+    for (const auto& p : poisoned) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::isfinite(p[axis])) {
+                expectedMin[axis] = std::min(expectedMin[axis], p[axis]);
+                expectedMax[axis] = std::max(expectedMax[axis], p[axis]);
+            }
+        }
+    }
+    min = glm::vec3(FLT_MAX);
+    max = glm::vec3(-FLT_MAX);
+    boundsScalar(poisoned.data(), poisoned.size(), min, max);
+    boundsOf(poisoned.data(), poisoned.size(), lo, hi);
+    Octree poisonedTree(0.25f, 512.0f);
+    poisonedTree.build(poisoned.data(), poisoned.size());
+    printf("31 points with inf / NaN :\tfitted %.1f m root\n", poisonedTree.getRootSize());
+    if (min != expectedMin || max != expectedMax || lo != expectedMin || hi != expectedMax ||
+        !std::isfinite(poisonedTree.getRootSize()) || poisonedTree.getLeafCount() == 0)
+        printf("MISMATCH : non-finite coordinates reached the bounds\n");
+
+    // a 12 x 3 x 8 m room
+    std::vector<glm::vec3> room(cloud.size());
+    for (size_t i = 0; i < cloud.size(); i++)
+        room[i] = glm::vec3(20.0f, 0.0f, -35.0f) + (cloud[i] + glm::vec3(100.0f, 2.0f, 100.0f)) * glm::vec3(0.06f, 0.15f, 0.04f);
+    std::vector<glm::vec3> leaves[2];
+    for (int fitted = 0; fitted < 2; fitted++) {
+        Octree octree(0.25f, 512.0f);
+        if (fitted) {
+            boundsOf(room.data(), room.size(), lo, hi);
+            octree.fit(lo, hi);
+        }
+        t0 = now();
+        insertAll(octree, room);
+        t1 = now();
+        printf("room, %s root :\t%.1f m\t%u levels\t%zu nodes\t%.1f ns per point\n",
+            fitted ? "fitted" : "512 m", octree.getRootSize(), octree.getMaxDepth(), octree.getNodeCount(),
+            (t1 - t0) / room.size() * 1e9);
+        octree.octreeToVector(octree.getRoot(), leaves[fitted]);
+        std::sort(leaves[fitted].begin(), leaves[fitted].end(), lessVec);
+    }
+    if (leaves[0] != leaves[1])
+        printf("MISMATCH : the fitted root changes the voxels\n");
+
+    // the same cloud 400 m east, once into the 512 m root, once bulk built around it
+    std::vector<glm::vec3> far(cloud);
+    for (auto& p : far)
+        p.x += 400.0f;
+    Octree grown(0.25f, 512.0f);
+    t0 = now();
+    insertAll(grown, far);
+    t1 = now();
+    Octree fitted(0.25f, 512.0f);
+    fitted.build(far.data(), far.size());
+    std::vector<glm::vec3> a, b;
+    grown.octreeToVector(grown.getRoot(), a);
+    fitted.octreeToVector(fitted.getRoot(), b);
+    printf("400 m out :\tgrown to %.1f m, %u levels, %zu leaves\tbulk built in %.1f m, %zu leaves\t%.3f s\n",
+        grown.getRootSize(), grown.getMaxDepth(), a.size(), fitted.getRootSize(), b.size(), t1 - t0);
+    std::sort(a.begin(), a.end(), lessVec);
+    std::sort(b.begin(), b.end(), lessVec);
+    if (a != b)
+        printf("MISMATCH : a grown root gives other voxels than a fitted one\n");
+
+    // a stream drifting outward doubles the root again and again; each doubling only
+    // adds a root, however large the tree below it
+    size_t before = grown.getNodeCount();
+    unsigned int depth = grown.getMaxDepth();
+    t0 = now();
+    for (float x = 1000.0f; x < 1.0e6f; x *= 2.0f)
+        grown.insert(grown.getRoot(), glm::vec3(x, 0.1f, 0.1f));
+    t1 = now();
+    std::vector<glm::vec3> drifted;
+    grown.octreeToVector(grown.getRoot(), drifted);
+    printf("drift to 1000 km :\t%u doublings\t%.1f us\n", grown.getMaxDepth() - depth, (t1 - t0) * 1e6);
+    if (drifted.size() != a.size() + 10 || grown.getNodeCount() <= before)
+        printf("MISMATCH : drifting points were lost\n");
+}
+
+// box crops of a few sizes around random leaves: a filter over every leaf against the
+// pruned descents of the pointer and compact octrees, the latter with and without its
+// leaf index, on the usual sparse cloud and on the same points squeezed into
+// 40 x 10 x 40 m, where most cells are filled
+static void benchBoxCloud(size_t count, bool dense)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    if (dense) {
+        for (auto& p : cloud)
+            p *= glm::vec3(0.2f, 0.5f, 0.2f);
+    }
+    Octree octree(0.25f, 512.0f);
+    octree.build(cloud.data(), cloud.size());
+    CompactOctree compact, indexed;
+    compact.build(octree);
+    indexed.build(octree);
+    indexed.indexLeaves();
+    std::vector<glm::vec3> leaves;
+    octree.octreeToVector(octree.getRoot(), leaves);
+    printf("points :\t%zu\tleaves %zu\n", cloud.size(), leaves.size());
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> pick(0, leaves.size() - 1);
+    for (float size : { 2.0f, 10.0f, 50.0f }) {
+        const int queries = size < 20.0f ? 200 : 20;
+        std::vector<glm::vec3> mins(queries), maxs(queries);
+        for (int q = 0; q < queries; q++) {
+            // boxes off the lattice, so most nodes are cut by a face somewhere
+            mins[q] = leaves[pick(rng)] - glm::vec3(size * 0.5f) + glm::vec3(0.01f, 0.07f, 0.13f);
+            maxs[q] = mins[q] + glm::vec3(size, size * 0.5f, size);
+        }
+        std::vector<glm::vec3> found[4];
+        double seconds[4];
+        size_t total = 0;
+        for (int path = 0; path < 4; path++) {
+            double t0 = now();
+            for (int q = 0; q < queries; q++) {
+                std::vector<glm::vec3> out;
+                if (path == 0) {
+                    for (const auto& c : leaves) {
+                        if (c.x >= mins[q].x && c.y >= mins[q].y && c.z >= mins[q].z &&
+                            c.x <= maxs[q].x && c.y <= maxs[q].y && c.z <= maxs[q].z)
+                            out.push_back(c);
+                    }
+                }
+                else if (path == 1)
+                    octree.findInBox(mins[q], maxs[q], out);
+                else if (path == 2)
+                    compact.findInBox(mins[q], maxs[q], out);
+                else
+                    indexed.findInBox(mins[q], maxs[q], out);
+                if (path == 0)
+                    total += out.size();
+                found[path].insert(found[path].end(), out.begin(), out.end());
+            }
+            seconds[path] = now() - t0;
+        }
+        printf("box %.0f x %.0f x %.0f m, %zu voxels each :\tscan %.1f us\toctree %.1f us\tcompact %.1f us\tindexed %.1f us\n",
+            size, size * 0.5f, size, total / queries, seconds[0] / queries * 1e6, seconds[1] / queries * 1e6,
+            seconds[2] / queries * 1e6, seconds[3] / queries * 1e6);
+        // the scan follows octreeToVector order, and so do the descents
+        if (found[1] != found[0] || found[2] != found[0] || found[3] != found[0])
+            printf("MISMATCH : box query leaves differ from the scan\n");
+    }
+}
+
+static void benchBox(size_t count)
+{
+    for (int dense = 0; dense < 2; dense++) {
+        printf("%s cloud\n", dense ? "dense" : "sparse");
+        benchBoxCloud(count, dense != 0);
+    }
+}
+
+// the render loop's slab query: findByY against the exactly pruned findInSlab, and a
+// camera drifting up and down over 1000 frames, queried every frame against the cache
+static void benchSlab(size_t count)
+{
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    Octree octree(0.25f, 512.0f);
+    octree.build(cloud.data(), cloud.size());
+    CompactOctree compact;
+    compact.build(octree);
+    const float leaf = octree.getLeafSize();
+
+    // heights off the layer centres, where the two queries must agree
+    std::vector<float> heights;
+    for (float y = -1.9f; y < 18.0f; y += 0.49f)
+        heights.push_back(y);
+    double seconds[4] = { 0.0, 0.0, 0.0, 0.0 };
+    size_t voxels = 0, wrong = 0;
+    for (float y : heights) {
+        float yMin, yMax;
+        SlabCache::slabBounds(SlabCache::slabOf(y, leaf), leaf, yMin, yMax);
+        std::vector<glm::vec3> found[4];
+        double t0 = now();
+        octree.findByY(octree.getRoot(), y, found[0]);
+        double t1 = now();
+        octree.findInSlab(yMin, yMax, found[1]);
+        double t2 = now();
+        compact.findByY(y, found[2]);
+        double t3 = now();
+        compact.findInSlab(yMin, yMax, found[3]);
+        double t4 = now();
+        seconds[0] += t1 - t0;
+        seconds[1] += t2 - t1;
+        seconds[2] += t3 - t2;
+        seconds[3] += t4 - t3;
+        voxels += found[0].size();
+        wrong += found[1] != found[0] || found[2] != found[0] || found[3] != found[0];
+    }
+    printf("slab, %zu voxels each :\tfindByY %.2f ms\tfindInSlab %.2f ms\tcompact findByY %.2f ms\tcompact findInSlab %.2f ms\n",
+        voxels / heights.size(), seconds[0] / heights.size() * 1e3, seconds[1] / heights.size() * 1e3,
+        seconds[2] / heights.size() * 1e3, seconds[3] / heights.size() * 1e3);
+    if (wrong > 0)
+        printf("MISMATCH : findInSlab differs from findByY at %zu heights\n", wrong);
+
+    // 1000 frames, 2 cm per frame, turning round every 2 m
+    std::vector<float> path(1000);
+    for (size_t f = 0; f < path.size(); f++) {
+        float t = std::fmod(f * 0.02f, 4.0f);
+        path[f] = 1.5f + (t < 2.0f ? t : 4.0f - t);
+    }
+    double t0 = now();
+    for (float y : path) {
+        std::vector<glm::vec3> frame;
+        compact.findByY(y, frame);
+    }
+    double t1 = now();
+    SlabCache cache;
+    size_t queries = 0;
+    for (float y : path) {
+        queries += cache.update(y, leaf, octree.getVersion(), [&](float yMin, float yMax, std::vector<glm::vec3>& out) {
+            compact.findInSlab(yMin, yMax, out);
+        });
+    }
+    double t2 = now();
+    printf("%zu frames :\tfindByY every frame %.3f s\tcached %.3f s, %zu queries\t%.0fx\n",
+        path.size(), t1 - t0, t2 - t1, queries, (t1 - t0) / (t2 - t1));
+
+    // the flat backends take a slab as findByY halfway between its two layers, cached
+    // under a version of their own
+    VoxelHashGrid grid(leaf);
+    grid.insert(cloud.data(), cloud.size());
+    SlabCache gridCache;
+    size_t gridQueries = 0;
+    wrong = 0;
+    t0 = now();
+    for (float y : path) {
+        gridQueries += gridCache.update(y, leaf, 1, [&](float yMin, float yMax, std::vector<glm::vec3>& out) {
+            grid.findByY(0.5f * (yMin + yMax), out);
+        });
+    }
+    t1 = now();
+    for (float y : heights) {
+        float yMin, yMax;
+        SlabCache::slabBounds(SlabCache::slabOf(y, leaf), leaf, yMin, yMax);
+        std::vector<glm::vec3> a, b;
+        grid.findByY(0.5f * (yMin + yMax), a);
+        octree.findInSlab(yMin, yMax, b);
+        std::sort(a.begin(), a.end(), lessVec);
+        std::sort(b.begin(), b.end(), lessVec);
+        wrong += a != b;
+    }
+    printf("hash grid, %zu frames :\tcached %.3f s, %zu queries\n", path.size(), t1 - t0, gridQueries);
+    if (wrong > 0 || gridQueries != queries)
+        printf("MISMATCH : hash grid slab differs from the octree's at %zu heights\n", wrong);
+
+    // a new leaf in the slab must invalidate it, and show up in the next query
+    float y = path.back();
+    float yMin, yMax;
+    SlabCache::slabBounds(SlabCache::slabOf(y, leaf), leaf, yMin, yMax);
+    size_t before = cache.voxels().size();
+    bool created = octree.insert(octree.getRoot(), glm::vec3(150.1f, yMin + 0.01f, 150.1f));
+    bool requeried = cache.update(y, leaf, octree.getVersion(), [&](float lo, float hi, std::vector<glm::vec3>& out) {
+        octree.findInSlab(lo, hi, out);
+    });
+    if (!created || !requeried || cache.voxels().size() != before + 1)
+        printf("MISMATCH : a new leaf did not invalidate the cached slab\n");
+}
+
+// scalar against batch voxel-key codecs; both must produce the same keys and centres
+static void benchKeys(size_t count)
+{
+    const float voxelSize = 0.25f;
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    printf("points :\t%zu\tvector codec : %s\n", cloud.size(), hasVectorCodec() ? "avx2 + bmi2" : "none");
+
+    std::vector<uint64_t> scalar(cloud.size()), batch(cloud.size());
+    std::vector<glm::vec3> scalarCentres(cloud.size()), batchCentres(cloud.size());
+
+    double t0 = now();
+    for (size_t i = 0; i < cloud.size(); i++)
+        scalar[i] = VoxelKey::fromPoint(cloud[i], voxelSize).Value;
+    double t1 = now();
+    encodeVoxelKeys(cloud.data(), cloud.size(), voxelSize, batch.data());
+    double t2 = now();
+    printf("voxel key encode :\tscalar %.3f s\tbatch %.3f s\t(%.1fx)\n", t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+    if (scalar != batch)
+        printf("MISMATCH : batch voxel keys differ from scalar\n");
+
+    t0 = now();
+    for (size_t i = 0; i < batch.size(); i++)
+        scalarCentres[i] = VoxelKey(batch[i]).centre(voxelSize);
+    t1 = now();
+    decodeVoxelKeys(batch.data(), batch.size(), voxelSize, batchCentres.data());
+    t2 = now();
+    printf("voxel key decode :\tscalar %.3f s\tbatch %.3f s\t(%.1fx)\n", t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+    if (scalarCentres != batchCentres)
+        printf("MISMATCH : batch voxel centres differ from scalar\n");
+
+    t0 = now();
+    for (size_t i = 0; i < cloud.size(); i++)
+        scalar[i] = VoxelKey::fromPoint(cloud[i], voxelSize).morton();
+    t1 = now();
+    encodeMortonKeys(cloud.data(), cloud.size(), voxelSize, batch.data());
+    t2 = now();
+    printf("morton encode :\tscalar %.3f s\tbatch %.3f s\t(%.1fx)\n", t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+    if (scalar != batch)
+        printf("MISMATCH : batch morton keys differ from scalar\n");
+
+    t0 = now();
+    for (size_t i = 0; i < batch.size(); i++) {
+        int x, y, z;
+        mortonDecode(batch[i], x, y, z);
+        scalarCentres[i] = (glm::vec3(x, y, z) + 0.5f) * voxelSize;
+    }
+    t1 = now();
+    decodeMortonKeys(batch.data(), batch.size(), voxelSize, batchCentres.data());
+    t2 = now();
+    printf("morton decode :\tscalar %.3f s\tbatch %.3f s\t(%.1fx)\n", t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+    if (scalarCentres != batchCentres)
+        printf("MISMATCH : batch morton centres differ from scalar\n");
+
+    // negative indices must stay in their own field
+    VoxelKey k(-1, 0, -1);
+    if (k.x() != -1 || k.y() != 0 || k.z() != -1 || VoxelKey(0, -1, 0) == VoxelKey(-1, 0, 0))
+        printf("MISMATCH : negative voxel indices bleed across fields\n");
+}
+
+// one pass over the points for the whole pyramid, against a full rebuild per voxel size
+static void benchPyramid(size_t count)
+{
+    const float voxelSize = 0.25f;
+    std::vector<glm::vec3> cloud;
+    makeCloud(count, cloud);
+    printf("points :\t%zu\n", cloud.size());
+
+    VoxelPyramid pyramid(voxelSize, 4);
+    double t0 = now();
+    pyramid.build(cloud);
+    double t1 = now();
+    printf("pyramid, one pass :\t%.3f s\n", t1 - t0);
+
+    double rebuild = 0.0;
+    for (size_t i = 0; i < pyramid.levelCount(); i++) {
+        const MortonVoxelSet& level = pyramid.level(i);
+        MortonVoxelSet direct(level.getVoxelSize());
+        t0 = now();
+        direct.build(cloud);
+        t1 = now();
+        rebuild += t1 - t0;
+
+        std::vector<glm::vec3> a = level.Voxels;
+        std::vector<glm::vec3> b = direct.Voxels;
+        std::sort(a.begin(), a.end(), lessVec);
+        std::sort(b.begin(), b.end(), lessVec);
+        printf("level %zu :\t%.2f m\t%zu voxels\n", i, level.getVoxelSize(), level.size());
+        if (a != b)
+            printf("MISMATCH : level %zu differs from a direct build at %.2f m\n", i, level.getVoxelSize());
+    }
+    printf("rebuild per level :\t%.3f s\n", rebuild);
+}
+
+// start a new high-water mark for VmHWM; false where the kernel does not allow it
+static bool resetPeakResident()
+{
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file == nullptr)
+        return false;
+    bool ok = fputs("5", file) >= 0;
+    return fclose(file) == 0 && ok;
+}
+
+// background rebuilds at several voxel sizes while the main thread keeps "rendering"
+static void benchResize(size_t count)
+{
+    std::shared_ptr<std::vector<glm::vec3>> cloud = std::make_shared<std::vector<glm::vec3>>();
+    makeCloud(count, *cloud);
+    printf("points :\t%zu\tresident %.1f MB\n", cloud->size(), residentBytes("VmRSS:") / 1048576.0);
+
+    std::shared_ptr<VoxelPyramid> current = std::make_shared<VoxelPyramid>(0.25f, 4);
+    current->build(*cloud);
+
+    PyramidRebuilder rebuilder;
+    const float sizes[] = { 0.5f, 0.125f, 1.0f, 0.25f };
+    for (float size : sizes) {
+        bool measured = resetPeakResident();
+        size_t before = residentBytes("VmRSS:");
+        rebuilder.start(std::shared_ptr<const std::vector<glm::vec3>>(cloud), size, 4);
+        // stand-in for frames drawn from the old pyramid while the worker runs
+        size_t frames = 0;
+        std::shared_ptr<VoxelPyramid> rebuilt;
+        while ((rebuilt = rebuilder.poll()) == nullptr) {
+            std::vector<glm::vec3> slab;
+            current->findByY(0, 1.0f, slab);
+            frames++;
+        }
+        size_t peak = residentBytes("VmHWM:");
+        current = rebuilt;
+        printf("rebuild at %.3f m :\t%zu voxels\t%.3f s\t%.1f MB structure\t%.1f MB growth\t%.1f MB peak\t%zu frames meanwhile\n",
+            size, current->level(0).size(), rebuilder.Seconds, rebuilder.StructureBytes / 1048576.0,
+            rebuilder.GrowthBytes / 1048576.0, (measured && peak > before) ? (peak - before) / 1048576.0 : 0.0, frames);
+    }
+}
+
+// a flat, slightly noisy ground with a share of spray points scattered above it;
+// spray points come last
+static void makeSprayScene(size_t count, size_t spray, std::vector<glm::vec3>& vertices)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> xz(-50.0f, 50.0f);
+    std::normal_distribution<float> ground(0.0f, 0.02f);
+    std::uniform_real_distribution<float> air(0.5f, 10.0f);
+    vertices.resize(count + spray);
+    for (size_t i = 0; i < count; i++)
+        vertices[i] = glm::vec3(xz(rng), ground(rng), xz(rng));
+    for (size_t i = count; i < count + spray; i++)
+        vertices[i] = glm::vec3(xz(rng), air(rng), xz(rng));
+}
+
+static void reportOutliers(const char* label, double seconds, size_t before, size_t removed)
+{
+    printf("%s :\t%zu removed of %zu\t%.3f s\t%.1f Mpoints/s\n", label, removed, before, seconds, before / seconds / 1e6);
+}
+
+static void benchOutliers(size_t count)
+{
+    const float radius = 0.5f;
+    const size_t spray = count / 100;
+    std::vector<glm::vec3> scene;
+    makeSprayScene(count, spray, scene);
+    printf("points :\t%zu ground\t%zu spray\n", count, spray);
+
+    // a spray point survives when its height says so; ground points never leave the plane
+    auto countSpray = [](const std::vector<glm::vec3>& points) {
+        size_t n = 0;
+        for (const auto& p : points)
+            n += p.y > 0.25f;
+        return n;
+    };
+
+    std::vector<glm::vec3> points = scene;
+    double t0 = now();
+    size_t removed = radiusOutlierFilter(points, radius, 2);
+    double t1 = now();
+    reportOutliers("radius filter", t1 - t0, scene.size(), removed);
+    printf("radius filter :\t%zu spray left\t%zu ground lost\n", countSpray(points), count - (points.size() - countSpray(points)));
+    std::vector<glm::vec3> single = scene;
+    radiusOutlierFilter(single, radius, 2, 1);
+    if (single != points)
+        printf("MISMATCH : radius filter depends on the thread count\n");
+
+    points = scene;
+    t0 = now();
+    removed = statisticalOutlierFilter(points, 8, 3.0f, radius);
+    t1 = now();
+    reportOutliers("statistical filter", t1 - t0, scene.size(), removed);
+    printf("statistical filter :\t%zu spray left\t%zu ground lost\n", countSpray(points), count - (points.size() - countSpray(points)));
+    single = scene;
+    statisticalOutlierFilter(single, 8, 3.0f, radius, 1);
+    if (single != points)
+        printf("MISMATCH : statistical filter depends on the thread count\n");
+
+    // brute force on a slice small enough for O(n^2)
+    std::vector<glm::vec3> small(scene.begin(), scene.begin() + std::min<size_t>(scene.size(), 20000));
+    std::vector<glm::vec3> expected;
+    const size_t sliceSize = small.size();
+    t0 = now();
+    for (size_t i = 0; i < small.size(); i++) {
+        unsigned int found = 0;
+        for (size_t j = 0; j < small.size(); j++) {
+            glm::vec3 d = small[j] - small[i];
+            if (j != i && glm::dot(d, d) <= radius * radius)
+                found++;
+        }
+        if (found >= 2)
+            expected.push_back(small[i]);
+    }
+    t1 = now();
+    std::vector<glm::vec3> slice(small);
+    radiusOutlierFilter(small, radius, 2);
+    double t2 = now();
+    printf("brute force, %zu points :\t%.3f s\tgrid %.3f s\n", sliceSize, t1 - t0, t2 - t1);
+    if (small != expected)
+        printf("MISMATCH : radius filter differs from brute force\n");
+
+    // the statistical filter's k nearest, found by sorting every distance within radius
+    const unsigned int k = 8;
+    std::vector<float> means(slice.size());
+    for (size_t i = 0; i < slice.size(); i++) {
+        std::vector<float> distances;
+        for (size_t j = 0; j < slice.size(); j++) {
+            glm::vec3 d = slice[j] - slice[i];
+            if (j != i && glm::dot(d, d) <= radius * radius)
+                distances.push_back(glm::dot(d, d));
+        }
+        std::sort(distances.begin(), distances.end());
+        means[i] = -1.0f;
+        if (distances.size() >= k) {
+            float sum = 0.0f;
+            for (unsigned int n = 0; n < k; n++)
+                sum += std::sqrt(distances[n]);
+            means[i] = sum / k;
+        }
+    }
+    double sum = 0.0, sum2 = 0.0;
+    size_t dense = 0;
+    for (float m : means) {
+        if (m >= 0.0f) {
+            sum += m;
+            sum2 += static_cast<double>(m) * m;
+            dense++;
+        }
+    }
+    double mean = sum / dense;
+    const float threshold = static_cast<float>(mean + 3.0 * std::sqrt(std::max(0.0, sum2 / dense - mean * mean)));
+    expected.clear();
+    for (size_t i = 0; i < slice.size(); i++) {
+        if (means[i] >= 0.0f && means[i] <= threshold)
+            expected.push_back(slice[i]);
+    }
+    statisticalOutlierFilter(slice, k, 3.0f, radius);
+    if (slice != expected)
+        printf("MISMATCH : statistical filter differs from brute force\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode = argc > 1 ? argv[1] : "load";
+    std::string arg = argc > 2 ? argv[2] : "";
+
+    if (mode == "load")
+        benchLoad(arg);
+    else if (mode == "playback")
+        benchPlayback(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "ingest")
+        benchIngest(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "quantize")
+        benchQuantize(arg.empty() ? 2000000 : std::stoul(arg));
+    else if (mode == "downsample")
+        benchDownsample(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "octree")
+        benchOctree(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "linear")
+        benchLinearOctree(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "slab")
+        benchSlab(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "box")
+        benchBox(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "bounds")
+        benchBounds(arg.empty() ? 4000000 : std::stoul(arg));
+    else if (mode == "pyramid")
+        benchPyramid(arg.empty() ? 4000000 : std::stoul(arg));
+    else if (mode == "resize")
+        benchResize(arg.empty() ? 4000000 : std::stoul(arg));
+    else if (mode == "outliers")
+        benchOutliers(arg.empty() ? 1000000 : std::stoul(arg));
+    else if (mode == "keys")
+        benchKeys(arg.empty() ? 4000000 : std::stoul(arg));
+    else if (mode == "formats")
+        benchFormats(arg.empty() ? 2000000 : std::stoul(arg));
+    else
+        printf("unknown benchmark : %s\n", mode.c_str());
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include "glm/glm/glm.hpp"
+
+#include "source/loader.h"
+#include "source/cloudfile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// converts "x y z" text dumps into the binary .pcld format
+// usage : ./convert input.txt [output.pcld] [voxelsize]
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage : %s input.txt [output.pcld] [voxelsize]\n", argv[0]);
+        return 1;
+    }
+
+    std::string input = argv[1];
+    std::string output = argc > 2 ? argv[2] : input.substr(0, input.find_last_of('.')) + ".pcld";
+    float voxelSize = argc > 3 ? static_cast<float>(atof(argv[3])) : 0.0f;
+
+    std::vector<glm::vec3> vertices;
+    readVerticesParallel(input, vertices);
+    if (vertices.empty()) {
+        printf("no points read from %s\n", input.c_str());
+        return 1;
+    }
+
+    if (!writeCloudFile(output, vertices, voxelSize))
+        return 1;
+
+    printf("%s -> %s :\t%zu points\n", input.c_str(), output.c_str(), vertices.size());
+    return 0;
+}
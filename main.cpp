@@ -9,8 +9,26 @@
 #include "source/camera.h"
 #include "source/object.h"
 #include "source/octree.h"
+#include "source/compactoctree.h"
+#include "source/linearoctree.h"
+#include "source/bounds.h"
+#include "source/slabcache.h"
+#include "source/loader.h"
+#include "source/cloudfile.h"
+#include "source/reader.h"
+#include "source/progressive.h"
+#include "source/playback.h"
+#include "source/ingest.h"
+#include "source/quantized.h"
+#include "source/hashgrid.h"
+#include "source/voxelfilter.h"
+#include "source/voxelsort.h"
+#include "source/pyramid.h"
+#include "source/rebuild.h"
+#include "source/outlier.h"
 
 #include <iostream>
+#include <memory>
 #include <unordered_map>
 #include <tuple>
 
@@ -24,9 +42,16 @@ void processInput(GLFWwindow* window);
 
 void readVerticesFromFile(const std::string& filename, std::vector<glm::vec3>& vertices);
 void downsample(std::vector<glm::vec3>& vertices, const float gridSize);
-void summarize(glm::vec3& mypos, std::vector<glm::vec3>& boxvec, std::vector<glm::vec3>& filteredboxvec);
+void downsample(QuantizedCloud& cloud);
+void removeOutliers(std::vector<glm::vec3>& points);
+void freezeOctree();
+size_t mergeScan(const glm::vec3* points, size_t count, std::vector<glm::vec3>& newVoxels);
+void summarize(glm::vec3& mypos, const std::vector<glm::vec3>& boxvec, std::vector<glm::vec3>& filteredboxvec);
+void voxelsToVector(std::vector<glm::vec3>& voxels);
+bool findVoxelsByY(float y);
+void showPyramidLevel(size_t level, bool force = false);
+void resizeVoxels(float factor);
 
-unsigned long long makeUniqueNumber(glm::vec3 vertex, const float boxSize);
 
 // settings
 const unsigned int SCR_WIDTH = 1280; // 800;
@@ -37,10 +62,16 @@ Camera camera;
 // Camera camera(glm::vec3(0.0f, 60.0f, 25.0f), glm::vec3(0.0f, 1.0f, 0.0f), 00.0f, -89.0f);
 
 Point* pointcloud = nullptr;
+// set instead of pointcloud when running with --quantized
+QuantizedPoint* qpointcloud = nullptr;
+// decoded voxel centres of qpointcloud for the box view, filled by downsample
+std::vector<glm::vec3> qvoxels;
 Box* box = nullptr;
 
 const float VOXELSIZE = 0.25f;
 
+bool isLoaded = false;
+bool isLive = false;
 bool isDownsapled = false;
 bool isSummarized = false;
 
@@ -48,13 +79,102 @@ bool isSummarized = false;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// downsample() backend, switched with 'O' / 'H' / 'M' / 'C' (or --hashgrid, --morton, --centroid) before pressing 'P'
+enum DownsampleBackend
+{
+    BACKEND_OCTREE,
+    BACKEND_HASHGRID,
+    BACKEND_MORTON,
+    BACKEND_CENTROID
+};
+DownsampleBackend downsampleBackend = BACKEND_OCTREE;
+// centroid voxels backed by fewer points than this are dropped as noise (--min-points=N)
+uint32_t minVoxelPoints = 1;
+
+// outlier removal, the first stage of downsample(); off unless asked for with
+// --radius-outlier[=radius,minNeighbours] or --statistical-outlier[=k,stddevMul,radius]
+enum OutlierFilter
+{
+    OUTLIER_NONE,
+    OUTLIER_RADIUS,
+    OUTLIER_STATISTICAL
+};
+OutlierFilter outlierFilter = OUTLIER_NONE;
+float outlierRadius = 0.5f;
+// minimum neighbours for the radius filter, k for the statistical one
+unsigned int outlierNeighbours = 2;
+// one sigma would also drop the sparser stretches of genuine surface
+float outlierStddev = 3.0f;
+
+// starts as a 512 m cube; downsample() fits it to the cloud, and merged scans that fall
+// outside make it grow
 Octree octree(VOXELSIZE, 512.0f);
-
-std::vector<glm::vec3> backupboxvec;
+// a static cloud's octree is final once downsampled: it is kept as this read-only copy,
+// a tenth of the size, and the pointer tree is freed (freezeOctree). live maps keep
+// growing in the pointer tree and have no copy
+CompactOctree compactoctree;
+VoxelHashGrid hashgrid(VOXELSIZE);
+// every downsample also fills the pyramid (0.25, 0.5, 1, 2 m), shown with F1-F4.
+// '-' / '=' rebuild it from the raw points at half / double the size in the background;
+// once a rebuilt pyramid is swapped in it serves level 0 as well (isResized)
+std::shared_ptr<VoxelPyramid> pyramid = std::make_shared<VoxelPyramid>(VOXELSIZE, 4);
+size_t pyramidLevel = 0;
+float drawVoxelSize = VOXELSIZE;
+bool isResized = false;
+PyramidRebuilder rebuilder;
+// the points downsample() replaced, kept for rebuilds; one of the two is set
+std::shared_ptr<const std::vector<glm::vec3>> rawpoints;
+std::shared_ptr<const QuantizedCloud> rawcloud;
+CentroidVoxelFilter centroidfilter(VOXELSIZE);
+ProgressiveLoader loader;
+
+// voxels of the highlighted slab; queried again only when the camera changes slab or
+// the voxels change, see findVoxelsByY
+SlabCache slabcache;
+// what the octree's version is for the other backends and the pyramid: bumped whenever
+// the voxels they show change (downsample, merged scans, a rebuilt pyramid, another level)
+uint64_t voxelVersion = 0;
+// the same voxels as a table, so the plain pass can skip them with one hash probe each;
+// refilled with the slab and kept so it does not reallocate
+LinearOctree slabvoxels(VOXELSIZE, 512.0f);
+float slabVoxelSize = VOXELSIZE;
+std::vector<uint8_t> inslab;
 std::vector<glm::vec3> filteredvec;
 
-int main()
+int main(int argc, char** argv)
 {
+    // a file is shown as one cloud, a directory or glob is played back as a scan sequence,
+    // and "unix:/path/to.sock" listens for live batches from the robot
+    // --quantized keeps a single cloud in 16-bit fixed point on the CPU and the GPU
+    std::vector<std::string> args;
+    bool useQuantized = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--quantized")
+            useQuantized = true;
+        else if (arg == "--hashgrid")
+            downsampleBackend = BACKEND_HASHGRID;
+        else if (arg == "--morton")
+            downsampleBackend = BACKEND_MORTON;
+        else if (arg == "--centroid")
+            downsampleBackend = BACKEND_CENTROID;
+        else if (arg.compare(0, 13, "--min-points=") == 0)
+            minVoxelPoints = static_cast<uint32_t>(atoi(arg.c_str() + 13));
+        else if (arg.compare(0, 16, "--radius-outlier") == 0) {
+            outlierFilter = OUTLIER_RADIUS;
+            sscanf(arg.c_str() + 16, "=%f,%u", &outlierRadius, &outlierNeighbours);
+        }
+        else if (arg.compare(0, 21, "--statistical-outlier") == 0) {
+            outlierFilter = OUTLIER_STATISTICAL;
+            outlierNeighbours = 8;
+            sscanf(arg.c_str() + 21, "=%u,%f,%f", &outlierNeighbours, &outlierStddev, &outlierRadius);
+        }
+        else
+            args.push_back(arg);
+    }
+    std::string cloudpath = args.size() > 0 ? args[0] : "/home/sp/robot_ws/output1.txt";
+    float playbackRate = args.size() > 1 ? static_cast<float>(atof(args[1].c_str())) : 10.0f;
+
     showInstructions();
 
     glfwInit();
@@ -89,10 +209,66 @@ int main()
     glEnable(GL_DEPTH_TEST);
 
     Shader shader("shaders/main_vert.glsl", "shaders/main_frag.glsl");
-
-    std::vector<glm::vec3> vertices;
-    readVerticesFromFile("/home/sp/robot_ws/output1.txt", vertices);
-    pointcloud = new Point(vertices);
+    Shader qshader("shaders/quant_vert.glsl", "shaders/main_frag.glsl");
+
+    FramePlayer* player = nullptr;
+    float lastPlayback = 0.0f;
+    SocketIngest* ingest = nullptr;
+    if (isSocketPath(cloudpath)) {
+        ingest = new SocketIngest(cloudpath.substr(5));
+        if (!ingest->start()) {
+            // start() has said why
+            delete ingest;
+            glfwTerminate();
+            return -1;
+        }
+        printf("listening on %s\n", ingest->Path.c_str());
+        pointcloud = new Point(static_cast<size_t>(1 << 20));
+        isLoaded = true;
+        isLive = true;
+        if (downsampleBackend == BACKEND_MORTON) {
+            printf("morton sort only works on whole clouds, using the octree for live input\n");
+            downsampleBackend = BACKEND_OCTREE;
+        }
+    }
+    else if (useQuantized && !isFramePattern(cloudpath)) {
+        // every format goes through the worker; chunks are quantized as they arrive
+        if (!loader.start(cloudpath)) {
+            std::cout << "Failed to load " << cloudpath << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        qpointcloud = new QuantizedPoint(static_cast<size_t>(loader.capacityHint()));
+    }
+    else if (isFramePattern(cloudpath)) {
+        player = new FramePlayer(listFrames(cloudpath));
+        printf("playing %ld frames at %.1f Hz\n", player->Frames.size(), playbackRate);
+        pointcloud = new Point(static_cast<size_t>(0));
+    }
+    else if (hasCloudExtension(cloudpath)) {
+        // binary cloud: upload straight from the mapping, nothing to parse
+        CloudFile cloud(cloudpath);
+        if (!cloud.isOpen()) {
+            glfwTerminate();
+            return -1;
+        }
+        pointcloud = new Point(cloud.Points, cloud.count());
+        isLoaded = true;
+    }
+    else {
+        // everything else streams in from a worker thread while we already draw
+        if (!loader.start(cloudpath)) {
+            std::cout << "Failed to load " << cloudpath << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        pointcloud = new Point(static_cast<size_t>(loader.capacityHint()));
+    }
+    // one frame's slice of live points; cleared every frame but keeps its capacity
+    std::vector<glm::vec3> incoming;
+    const size_t livePointsPerFrame = 1 << 18;
+    incoming.reserve(livePointsPerFrame);
+    std::vector<glm::vec3> newvoxels;
 
     while (!glfwWindowShouldClose(window)) {
 
@@ -103,6 +279,71 @@ int main()
         std::cout << "camera : " << camera.Position.x << ", " << camera.Position.y << ", " << camera.Position.z << std::endl;
         processInput(window);
 
+        if (ingest != nullptr) {
+            // the ring absorbs bursts; take a bounded slice each frame and grow the map with it
+            incoming.clear();
+            if (ingest->drain(incoming, livePointsPerFrame) > 0) {
+                newvoxels.clear();
+                mergeScan(incoming.data(), incoming.size(), newvoxels);
+                if (isDownsapled && downsampleBackend == BACKEND_CENTROID) {
+                    // old centroids move as points arrive, so the whole map is re-sent
+                    pointcloud->Positions.clear();
+                    voxelsToVector(pointcloud->Positions);
+                    pointcloud->Refresh();
+                }
+                else if (isDownsapled) {
+                    // only voxels this batch created have to reach the GPU
+                    pointcloud->Append(newvoxels.data(), newvoxels.size());
+                }
+                else {
+                    pointcloud->Append(incoming.data(), incoming.size());
+                }
+            }
+        }
+        else if (player != nullptr) {
+            // hold the sensor rate; if a frame is late we simply show the old one longer
+            if (currentFrame - lastPlayback >= 1.0f / playbackRate && player->next(incoming)) {
+                pointcloud->Swap(incoming);
+                lastPlayback = currentFrame;
+            }
+        }
+        else if (!isLoaded) {
+            // a bounded number of chunks per frame keeps the frame time flat
+            incoming.clear();
+            if (loader.poll(incoming, 16) > 0) {
+                if (qpointcloud != nullptr)
+                    qpointcloud->Append(incoming.data(), incoming.size());
+                else
+                    pointcloud->Append(incoming.data(), incoming.size());
+            }
+            if (loader.isDone()) {
+                isLoaded = true;
+                if (qpointcloud != nullptr) {
+                    // one draw call per occupied cell from now on
+                    qpointcloud->Cloud.regroup();
+                    qpointcloud->Refresh();
+                    printf("loaded points :\t%ld\n", qpointcloud->Cloud.size());
+                    printf("quantized chunks :\t%ld\t(%.1f MB instead of %.1f MB)\n", qpointcloud->Cloud.Chunks.size(),
+                        qpointcloud->Cloud.memoryBytes() / 1048576.0, qpointcloud->Cloud.size() * sizeof(glm::vec3) / 1048576.0);
+                }
+                else {
+                    printf("loaded points :\t%ld\n", pointcloud->Positions.size());
+                }
+            }
+        }
+
+        std::shared_ptr<VoxelPyramid> rebuilt = rebuilder.poll();
+        if (rebuilt != nullptr) {
+            // the old pyramid goes away with its last reference, right here between frames
+            pyramid = rebuilt;
+            isResized = true;
+            voxelVersion++;
+            printf("rebuilt at %.3f m :\t%ld voxels\t%.3f s\t%.1f MB structure\t%.1f MB resident growth\n",
+                pyramid->level(0).getVoxelSize(), pyramid->level(0).size(), rebuilder.Seconds,
+                rebuilder.StructureBytes / 1048576.0, rebuilder.GrowthBytes / 1048576.0);
+            showPyramidLevel(pyramidLevel, true);
+        }
+
         glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -122,7 +363,7 @@ int main()
                 for (const auto& pos : filteredvec) {
                     model = glm::mat4(1.0f);
                     model = glm::translate(model, pos);
-                    model = glm::scale(model, glm::vec3(VOXELSIZE / 2.0f));
+                    model = glm::scale(model, glm::vec3(drawVoxelSize / 2.0f));
                     shader.setMat4("model", model);
 
                     shader.setVec4("color", glm::vec4(229.0f / 255.0f, 83.0f / 255.0f, 0.0f, 1.0f));
@@ -132,17 +373,28 @@ int main()
                 }
             }
             else {
-                std::vector<glm::vec3> cboxvec;
-                octree.findByY(octree.getRoot(), camera.Position.y, cboxvec);
-                backupboxvec = cboxvec;
-                std::unordered_map<unsigned long long, bool> cboxmap;
+                bool changed = findVoxelsByY(camera.Position.y);
+                const std::vector<glm::vec3>& cboxvec = slabcache.voxels();
+                if (slabVoxelSize != drawVoxelSize) {
+                    slabvoxels = LinearOctree(drawVoxelSize, 512.0f);
+                    slabVoxelSize = drawVoxelSize;
+                    changed = true;
+                }
+                if (changed) {
+                    // the root follows the slab, wherever the cloud lies
+                    glm::vec3 slabMin, slabMax;
+                    if (boundsOf(cboxvec.data(), cboxvec.size(), slabMin, slabMax))
+                        slabvoxels.fit(slabMin, slabMax);
+                    else
+                        slabvoxels.clear();
+                    slabvoxels.insert(cboxvec.data(), cboxvec.size());
+                }
 
                 for (const auto& pos : cboxvec) {
-                    cboxmap[makeUniqueNumber(pos, VOXELSIZE)] = true;
 
                     model = glm::mat4(1.0f);
                     model = glm::translate(model, pos);
-                    model = glm::scale(model, glm::vec3(VOXELSIZE / 2.0f));
+                    model = glm::scale(model, glm::vec3(drawVoxelSize / 2.0f));
                     shader.setMat4("model", model);
 
                     shader.setVec4("color", glm::vec4(229.0f / 255.0f, 83.0f / 255.0f, 0.0f, 1.0f));
@@ -150,14 +402,18 @@ int main()
                     shader.setVec4("color", glm::vec4(0.0f));
                     box->DrawLine();
                 }
-                for (const auto& pos : pointcloud->Positions) {
-                    if (cboxmap.find(makeUniqueNumber(pos, VOXELSIZE)) != cboxmap.end()) {
+                const std::vector<glm::vec3>& voxels = (qpointcloud != nullptr) ? qvoxels : pointcloud->Positions;
+                inslab.resize(voxels.size());
+                slabvoxels.contains(voxels.data(), voxels.size(), inslab.data());
+                for (size_t i = 0; i < voxels.size(); i++) {
+                    const glm::vec3& pos = voxels[i];
+                    if (inslab[i]) {
                         continue;
                     }
 
                     model = glm::mat4(1.0f);
                     model = glm::translate(model, pos);
-                    model = glm::scale(model, glm::vec3(VOXELSIZE / 2.0f));
+                    model = glm::scale(model, glm::vec3(drawVoxelSize / 2.0f));
                     shader.setMat4("model", model);
 
                     shader.setVec4("color", glm::vec4(1.0f));
@@ -167,6 +423,14 @@ int main()
                 }
             }
         }
+        else if (qpointcloud != nullptr) {
+            qshader.use();
+            qshader.setMat4("projection", projection);
+            qshader.setMat4("view", view);
+            qshader.setMat4("model", glm::mat4(1.0f));
+            qshader.setVec4("color", glm::vec4(1.0f));
+            qpointcloud->Draw(qshader);
+        }
         else {
             shader.setVec4("color", glm::vec4(1.0f));
             pointcloud->Draw();
@@ -181,6 +445,9 @@ int main()
         glfwPollEvents();
     }
 
+    delete player;
+    delete ingest;
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -192,7 +459,10 @@ void showInstructions()
     printf("Click and Drag to Loock Around.\n");
     printf("Press 'W/A/S/D/Up/Down' to Move.\n");
     printf("Press 'Q/Esc' to quit.\n");
-    printf("Press 'P' to Downsample.\n");
+    printf("Press 'O/H/M/C' to pick the Octree, Hash grid, Morton sort or Centroid downsampler.\n");
+    printf("Press 'P' to Downsample (outliers are removed first with --radius-outlier / --statistical-outlier).\n");
+    printf("Press 'F1-F4' to show the 0.25/0.5/1/2 m voxel pyramid level after downsampling.\n");
+    printf("Press '-/=' to rebuild the voxels at half/double the size.\n");
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -216,15 +486,41 @@ void processInput(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
         camera.ProcessKeyboard(DOWN, deltaTime);
 
-    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
-        downsample(pointcloud->Positions, VOXELSIZE);
-        pointcloud->Refresh();
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !isDownsapled)
+        downsampleBackend = BACKEND_OCTREE;
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !isDownsapled)
+        downsampleBackend = BACKEND_HASHGRID;
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !isDownsapled && !isLive)
+        downsampleBackend = BACKEND_MORTON;
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !isDownsapled)
+        downsampleBackend = BACKEND_CENTROID;
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && isLoaded) {
+        if (qpointcloud != nullptr) {
+            downsample(qpointcloud->Cloud);
+            qpointcloud->Refresh();
+            qpointcloud->Cloud.decode(qvoxels);
+        }
+        else {
+            downsample(pointcloud->Positions, VOXELSIZE);
+            pointcloud->Refresh();
+        }
         box = new Box();
     }
+    for (int i = 0; i < 4; i++) {
+        if (glfwGetKey(window, GLFW_KEY_F1 + i) == GLFW_PRESS)
+            showPyramidLevel(static_cast<size_t>(i));
+    }
+    // on the press only, holding the key should not queue one rebuild after another
+    static bool wasResizing = false;
+    bool halve = glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS;
+    bool twice = glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS;
+    if ((halve || twice) && !wasResizing)
+        resizeVoxels(halve ? 0.5f : 2.0f);
+    wasResizing = halve || twice;
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
         if (isDownsapled) {
             isSummarized = true;
-            summarize(camera.Position, backupboxvec, filteredvec);
+            summarize(camera.Position, slabcache.voxels(), filteredvec);
         }
     }
     if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
@@ -274,25 +570,31 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 // Put vertices in vertices array from file
 void readVerticesFromFile(const std::string& filename, std::vector<glm::vec3>& vertices)
 {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cout << "Failed to open file: " << filename << std::endl;
-        return;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        float x, y, z;
-        if (!(iss >> x >> y >> z)) {
-            std::cout << "Failed to read line: " << line << std::endl;
-            continue;
-        }
+    readPointFile(filename, vertices);
+}
 
-        vertices.emplace_back(x, y, z);
-    }
+// drop spray and ghost points before they turn into voxels of their own
+void removeOutliers(std::vector<glm::vec3>& points)
+{
+    if (outlierFilter == OUTLIER_NONE)
+        return;
+    size_t removed = 0;
+    if (outlierFilter == OUTLIER_RADIUS)
+        removed = radiusOutlierFilter(points, outlierRadius, outlierNeighbours);
+    else
+        removed = statisticalOutlierFilter(points, outlierNeighbours, outlierStddev, outlierRadius);
+    printf("outliers removed :\t%ld\n", removed);
+}
 
-    file.close();
+// swap the octree of a static cloud for its compact copy
+void freezeOctree()
+{
+    if (downsampleBackend != BACKEND_OCTREE || isLive)
+        return;
+    size_t before = octree.memoryBytes();
+    compactoctree.build(octree);
+    octree.release();
+    printf("compact octree :\t%.1f MB instead of %.1f MB\n", compactoctree.memoryBytes() / 1048576.0, before / 1048576.0);
 }
 
 void downsample(std::vector<glm::vec3>& vertices, const float gridSize)
@@ -300,84 +602,248 @@ void downsample(std::vector<glm::vec3>& vertices, const float gridSize)
     if (isDownsapled)
         return;
     isDownsapled = true;
+    removeOutliers(vertices);
 
-    /*
-        glm::vec3 min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
-        glm::vec3 max = glm::vec3(FLT_MIN, FLT_MIN, FLT_MIN);
-        for (const auto &vertex : vertices)
-        {
-            if (vertex.x < min.x)
-                min.x = vertex.x;
-            if (vertex.y < min.y)
-                min.y = vertex.y;
-            if (vertex.z < min.z)
-                min.z = vertex.z;
-
-            if (vertex.x > max.x)
-                max.x = vertex.x;
-            if (vertex.y > max.y)
-                max.y = vertex.y;
-            if (vertex.z > max.z)
-                max.z = vertex.z;
+    if (downsampleBackend == BACKEND_MORTON) {
+        pyramid->build(vertices);
+    }
+    else if (downsampleBackend == BACKEND_CENTROID) {
+        centroidfilter.insert(vertices.data(), vertices.size());
+    }
+    else if (downsampleBackend == BACKEND_OCTREE && octree.getLeafCount() == 0) {
+        // nothing merged yet, so the tree can be fitted to the cloud's bounds and bulk
+        // loaded from sorted keys
+        octree.build(vertices.data(), vertices.size());
+    }
+    else {
+        // collapse the cloud to unique voxels on every core first; a scan has many points
+        // per voxel, so the serial insert below only sees the survivors
+        ParallelVoxelGrid partial(gridSize);
+        partial.build(vertices);
+        printf("parallel voxel pass :\t%ld voxels\n", partial.size());
+        if (downsampleBackend == BACKEND_HASHGRID)
+            hashgrid.insert(partial.Voxels.data(), partial.Voxels.size());
+        else {
+            for (const auto& voxel : partial.Voxels)
+                octree.insert(octree.getRoot(), voxel);
         }
-    */
-
-    // auto combinedData = [](int _x, int _y, int _z) -> unsigned long long
-    //     {
-    //         unsigned long long x = static_cast<unsigned long long>(_x);
-    //         unsigned long long y = static_cast<unsigned long long>(_y);
-    //         unsigned long long z = static_cast<unsigned long long>(_z);
-    //         unsigned long long combined = (x << 42) | (y << 21) | z;
-    //         return combined;
-    //     };
-
-    // std::unordered_map<unsigned long long, glm::vec3> map;
-
-    for (const auto& vertex : vertices) {
-        // if (vertex.z >= 299.99) continue;
-        // float fx = floor(vertex.x / gridSize);
-        // float fy = floor(vertex.y / gridSize);
-        // float fz = floor(vertex.z / gridSize);
-
-        // int x = static_cast<int>(fx);
-        // int y = static_cast<int>(fy);
-        // int z = static_cast<int>(fz);
-
-        // auto combined = combinedData(x, y, z);
-
-        // auto it = map.find(combined);
-        // if (it == map.end())
-        //     map[combined] = std::move(glm::vec3(
-        //         fx * gridSize + gridSize / 2.0f,
-        //         fy * gridSize + gridSize / 2.0f,
-        //         fz * gridSize + gridSize / 2.0f));
-
-        octree.insert(octree.getRoot(), std::move(vertex));
     }
     // printf("number of leaves :\t%ld\n", octree.getLeafCount());
     // octree.printAllToFile(octree.getRoot(), "octreelog.txt");
 
+    freezeOctree();
+    voxelVersion++;
+
     std::vector<glm::vec3> ocvec;
-    octree.octreeToVector(octree.getRoot(), ocvec);
+    voxelsToVector(ocvec);
+    // the other backends hand over one centre per voxel, which lands in the same voxel
+    if (downsampleBackend != BACKEND_MORTON)
+        pyramid->build(ocvec);
 
     printf("number of points :\t%ld\n", vertices.size());
 
     printf("number of ocvec :\t%ld\n", ocvec.size());
 
-    // vertices.clear();
-    // vertices.reserve(map.size());
-    // for (const auto& entry : map)
-    //     vertices.push_back(entry.second);
-    // printf("number of voxel :\t%ld\n", vertices.size());
+    // keep the raw points for resizing, the caller gets the voxels in their place
+    std::shared_ptr<std::vector<glm::vec3>> raw = std::make_shared<std::vector<glm::vec3>>();
+    raw->swap(vertices);
+    rawpoints = raw;
+    vertices.swap(ocvec);
+}
+
+// same as above for a quantized cloud, decoded a block at a time: each block is
+// collapsed to unique voxels on every core, and only those voxels are kept as floats.
+// an outlier filter is the exception, it needs random access to neighbours and decodes
+// the whole cloud first
+void downsample(QuantizedCloud& cloud)
+{
+    if (isDownsapled)
+        return;
+    isDownsapled = true;
+    if (outlierFilter != OUTLIER_NONE) {
+        std::vector<glm::vec3> points;
+        cloud.decode(points);
+        removeOutliers(points);
+        cloud.assign(points);
+    }
+
+    if (downsampleBackend == BACKEND_MORTON) {
+        std::vector<uint64_t> keys;
+        keys.reserve(cloud.size());
+        cloud.forEach([&keys](const glm::vec3& vertex) {
+            keys.push_back(pyramid->level(0).keyOf(vertex));
+        });
+        pyramid->buildFromKeys(keys);
+    }
+    else if (downsampleBackend == BACKEND_CENTROID) {
+        cloud.forEachBlock([](const glm::vec3* points, size_t count) {
+            centroidfilter.insert(points, count);
+        });
+    }
+    else {
+        // a voxel cut by a block boundary comes out of both blocks; the hash grid and
+        // the octree's bulk build each keep it once
+        std::vector<glm::vec3> voxels;
+        ParallelVoxelGrid partial(VOXELSIZE);
+        cloud.forEachBlock([&](const glm::vec3* points, size_t count) {
+            partial.build(points, count);
+            voxels.insert(voxels.end(), partial.Voxels.begin(), partial.Voxels.end());
+        });
+        printf("parallel voxel pass :\t%ld voxels\n", voxels.size());
+        if (downsampleBackend == BACKEND_HASHGRID)
+            hashgrid.insert(voxels.data(), voxels.size());
+        else
+            octree.build(voxels.data(), voxels.size());
+    }
+
+    freezeOctree();
+    voxelVersion++;
+
+    std::vector<glm::vec3> ocvec;
+    voxelsToVector(ocvec);
+    // the other backends hand over one centre per voxel, which lands in the same voxel
+    if (downsampleBackend != BACKEND_MORTON)
+        pyramid->build(ocvec);
+
+    printf("number of points :\t%ld\n", cloud.size());
+
+    printf("number of ocvec :\t%ld\n", ocvec.size());
+
+    std::shared_ptr<QuantizedCloud> raw = std::make_shared<QuantizedCloud>(cloud.Scale);
+    raw->Offsets.swap(cloud.Offsets);
+    raw->Chunks.swap(cloud.Chunks);
+    rawcloud = raw;
+    cloud.assign(ocvec);
+}
+
+// incremental counterpart of downsample(): merge another scan into the existing map
+// and append only the voxels it created. works before and after downsample() and
+// for every backend that grows in place (not the Morton sort).
+size_t mergeScan(const glm::vec3* points, size_t count, std::vector<glm::vec3>& newVoxels)
+{
+    size_t before = newVoxels.size();
+    // centroids move with every point, so any batch changes what the slab shows
+    if (count > 0)
+        voxelVersion++;
+    if (downsampleBackend == BACKEND_HASHGRID) {
+        size_t first = hashgrid.size();
+        hashgrid.insert(points, count);
+        newVoxels.insert(newVoxels.end(), hashgrid.Voxels.begin() + first, hashgrid.Voxels.end());
+    }
+    else if (downsampleBackend == BACKEND_CENTROID) {
+        size_t first = centroidfilter.size();
+        centroidfilter.insert(points, count);
+        for (size_t i = first; i < centroidfilter.size(); i++) {
+            if (centroidfilter.Counts[i] >= minVoxelPoints)
+                newVoxels.push_back(centroidfilter.centroidOf(i));
+        }
+    }
+    else if (downsampleBackend == BACKEND_OCTREE) {
+        octree.insert(points, count, newVoxels);
+    }
+    return newVoxels.size() - before;
+}
+
+// voxel centres of whichever backend did the downsampling (centroids for the centroid filter)
+void voxelsToVector(std::vector<glm::vec3>& voxels)
+{
+    if (isResized)
+        voxels = pyramid->level(0).Voxels;
+    else if (downsampleBackend == BACKEND_HASHGRID)
+        voxels = hashgrid.Voxels;
+    else if (downsampleBackend == BACKEND_MORTON)
+        voxels = pyramid->level(0).Voxels;
+    else if (downsampleBackend == BACKEND_CENTROID)
+        centroidfilter.centroids(voxels, minVoxelPoints);
+    else if (compactoctree.size() > 0)
+        compactoctree.toVector(voxels);
+    else
+        octree.octreeToVector(octree.getRoot(), voxels);
+}
+
+// swap the drawn cloud for another level of the pyramid; live maps keep growing at
+// the base size only, so they stay on level 0
+void showPyramidLevel(size_t level, bool force)
+{
+    if (!isDownsapled || isLive || (level == pyramidLevel && !force) || level >= pyramid->levelCount())
+        return;
+    pyramidLevel = level;
+    voxelVersion++;
+    drawVoxelSize = pyramid->level(level).getVoxelSize();
+
+    // level 0 is whatever the backend produced, centroids included
+    std::vector<glm::vec3> voxels;
+    if (level == 0)
+        voxelsToVector(voxels);
+    else
+        voxels = pyramid->level(level).Voxels;
+
+    size_t count = voxels.size();
+    if (qpointcloud != nullptr) {
+        qpointcloud->Cloud.assign(voxels);
+        qpointcloud->Refresh();
+        qpointcloud->Cloud.decode(qvoxels);
+    }
+    else {
+        pointcloud->Positions.swap(voxels);
+        pointcloud->Refresh();
+    }
+    printf("pyramid level %ld :\t%.2f m\t%ld voxels\n", level, drawVoxelSize, count);
+}
 
+// start rebuilding the pyramid at factor times the current base size; the old one keeps
+// rendering until the main loop swaps the new one in
+void resizeVoxels(float factor)
+{
+    if (!isDownsapled || isLive || rebuilder.isBusy())
+        return;
+    float voxelSize = pyramid->level(0).getVoxelSize() * factor;
+    if (voxelSize < 1.0f / 64.0f || voxelSize > 16.0f)
+        return;
+    unsigned int levels = static_cast<unsigned int>(pyramid->levelCount());
+    bool started = (rawcloud != nullptr) ? rebuilder.start(rawcloud, voxelSize, levels)
+        : rebuilder.start(rawpoints, voxelSize, levels);
+    if (started)
+        printf("rebuilding at %.3f m ...\n", voxelSize);
+    // the pyramid keeps voxel centres only, so centroids are not shown again until 'P'
+    if (started && downsampleBackend == BACKEND_CENTROID)
+        printf("centroid view switches to voxel centres\n");
+}
 
-    vertices.clear();
-    vertices.reserve(ocvec.size());
-    for (const auto& o : ocvec)
-        vertices.push_back(o);
+// voxels in the camera's slab into slabcache; returns false if they are still last
+// frame's. the octree is versioned, so its slab is only queried when the camera moves
+// to another slab or leaves were added; the other backends and the pyramid are kept
+// the same way under voxelVersion. a static cloud is answered by the compact snapshot; a live map
+// never gets one, since every merged scan would make it stale, so the pointer tree
+// answers for as long as the map grows
+bool findVoxelsByY(float y)
+{
+    if (pyramidLevel == 0 && !isResized && downsampleBackend == BACKEND_OCTREE) {
+        return slabcache.update(y, octree.getLeafSize(), octree.getVersion(),
+            [](float yMin, float yMax, std::vector<glm::vec3>& voxels) {
+                if (compactoctree.size() > 0)
+                    compactoctree.findInSlab(yMin, yMax, voxels);
+                else
+                    octree.findInSlab(yMin, yMax, voxels);
+            });
+    }
+    // the octree's version and this one count separately, so a switch between the two
+    // must not look like the same slab
+    return slabcache.update(y, drawVoxelSize, voxelVersion | (1ull << 63), [](float yMin, float yMax, std::vector<glm::vec3>& voxels) {
+        // halfway between the slab's two layers, findByY takes exactly those two
+        float mid = 0.5f * (yMin + yMax);
+        if (pyramidLevel > 0 || isResized)
+            pyramid->findByY(pyramidLevel, mid, voxels);
+        else if (downsampleBackend == BACKEND_HASHGRID)
+            hashgrid.findByY(mid, voxels);
+        else if (downsampleBackend == BACKEND_MORTON)
+            pyramid->findByY(0, mid, voxels);
+        else
+            centroidfilter.findByY(mid, voxels, minVoxelPoints);
+    });
 }
 
-void summarize(glm::vec3& mypos, std::vector<glm::vec3>& boxvec, std::vector<glm::vec3>& filteredvec) {
+void summarize(glm::vec3& mypos, const std::vector<glm::vec3>& boxvec, std::vector<glm::vec3>& filteredvec) {
     filteredvec.clear();
     auto mypos2 = glm::vec2(mypos.x, mypos.z);
 
@@ -392,20 +858,3 @@ void summarize(glm::vec3& mypos, std::vector<glm::vec3>& boxvec, std::vector<glm
         polarmap[lltheta] = boxpos2;
     }
 }
-
-unsigned long long makeUniqueNumber(glm::vec3 vertex, const float boxSize) {
-    float fx = floor(vertex.x / boxSize);
-    float fy = floor(vertex.y / boxSize);
-    float fz = floor(vertex.z / boxSize);
-
-    int _x = static_cast<int>(fx);
-    int _y = static_cast<int>(fy);
-    int _z = static_cast<int>(fz);
-
-    unsigned long long x = static_cast<unsigned long long>(_x);
-    unsigned long long y = static_cast<unsigned long long>(_y);
-    unsigned long long z = static_cast<unsigned long long>(_z);
-    unsigned long long combined = (x << 42) | (y << 21) | z;
-
-    return combined;
-}
@@ -0,0 +1,65 @@
+#include "glm/glm/glm.hpp"
+
+#include "source/reader.h"
+#include "source/ingest.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// replays a cloud file into a live viewer socket in batches, like the robot would
+// usage : ./publish socket cloudfile [points per batch] [batches per second]
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("usage : %s socket cloudfile [points per batch] [batches per second]\n", argv[0]);
+        return 1;
+    }
+
+    std::string path = argv[1];
+    if (isSocketPath(path))
+        path = path.substr(5);
+    // an empty batch would never advance, one over MAX_BATCH_POINTS gets us dropped
+    long batchSize = argc > 3 ? atol(argv[3]) : 10000;
+    if (batchSize < 1 || batchSize > static_cast<long>(MAX_BATCH_POINTS)) {
+        printf("points per batch must be between 1 and %u\n", MAX_BATCH_POINTS);
+        printf("usage : %s socket cloudfile [points per batch] [batches per second]\n", argv[0]);
+        return 1;
+    }
+    double rate = argc > 4 ? atof(argv[4]) : 20.0;
+
+    std::vector<glm::vec3> vertices;
+    readPointFile(argv[2], vertices);
+    if (vertices.empty()) {
+        printf("no points read from %s\n", argv[2]);
+        return 1;
+    }
+
+    int fd = connectSocket(path);
+    if (fd < 0) {
+        printf("Failed to connect to %s\n", path.c_str());
+        return 1;
+    }
+
+    auto interval = std::chrono::duration<double>(rate > 0.0 ? 1.0 / rate : 0.0);
+    auto next = std::chrono::steady_clock::now();
+    size_t sent = 0;
+    while (sent < vertices.size()) {
+        uint32_t n = static_cast<uint32_t>(std::min(static_cast<size_t>(batchSize), vertices.size() - sent));
+        if (!sendBatch(fd, vertices.data() + sent, n)) {
+            printf("connection closed after %zu points\n", sent);
+            break;
+        }
+        sent += n;
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+        std::this_thread::sleep_until(next);
+    }
+    close(fd);
+
+    printf("published %zu points to %s\n", sent, path.c_str());
+    return 0;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aOffset;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// per-chunk dequantization, see source/quantized.h
+uniform vec3 origin;
+uniform float scale;
+
+void main()
+{
+	vec3 aPos = origin + aOffset * scale;
+	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+}
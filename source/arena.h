@@ -0,0 +1,110 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// nodes per arena block; 64k octree nodes are a few MB, large enough that block
+// allocation never shows up next to the inserts
+const size_t ARENA_BLOCK_NODES = 1 << 16;
+
+// fixed-size objects carved out of large contiguous blocks. create() is a pointer bump,
+// clear() rewinds to the first block without touching the objects or the allocator, and
+// the blocks themselves are only handed back when the arena goes. objects are never
+// destroyed one by one, so they must not need a destructor.
+template <typename T>
+class NodeArena
+{
+    static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+
+public:
+    NodeArena(size_t blockNodes = ARENA_BLOCK_NODES) : blockNodes(blockNodes) {}
+
+    ~NodeArena()
+    {
+        release();
+    }
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (cursor == end)
+            nextRun();
+        count++;
+        return new (cursor++) T(std::forward<Args>(args)...);
+    }
+
+    // forget every object but keep the blocks for the next build; O(1)
+    void clear() {
+        next = 0;
+        cursor = nullptr;
+        end = nullptr;
+        tails.clear();
+        count = 0;
+    }
+
+    // forget every object and free the blocks
+    void release() {
+        for (T* block : blocks)
+            ::operator delete(block);
+        blocks.clear();
+        clear();
+    }
+
+    // take over every block of other, objects included; other is left empty. the objects
+    // stay where they are, so pointers into them remain valid. the unused end of other's
+    // last block is filled by later create() calls before any fresh block is taken
+    void splice(NodeArena& other) {
+        if (other.cursor != other.end)
+            tails.push_back(std::make_pair(other.cursor, other.end));
+        tails.insert(tails.end(), other.tails.begin(), other.tails.end());
+        // filled blocks go in front of the one being filled, spare ones at the back
+        size_t at = next == 0 ? 0 : next - 1;
+        blocks.insert(blocks.begin() + at, other.blocks.begin(), other.blocks.begin() + other.next);
+        next += other.next;
+        blocks.insert(blocks.end(), other.blocks.begin() + other.next, other.blocks.end());
+        count += other.count;
+        other.blocks.clear();
+        other.clear();
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // bytes held, used or not
+    size_t memoryBytes() const {
+        return blocks.size() * blockNodes * sizeof(T);
+    }
+
+private:
+    size_t blockNodes;
+    std::vector<T*> blocks;
+    // blocks[next - 1] is being filled from cursor up to end
+    size_t next = 0;
+    T* cursor = nullptr;
+    T* end = nullptr;
+    // unused ends of spliced blocks, filled before the next block is taken
+    std::vector<std::pair<T*, T*>> tails;
+    size_t count = 0;
+
+    void nextRun() {
+        if (!tails.empty()) {
+            cursor = tails.back().first;
+            end = tails.back().second;
+            tails.pop_back();
+            return;
+        }
+        if (next == blocks.size())
+            blocks.push_back(static_cast<T*>(::operator new(blockNodes * sizeof(T))));
+        cursor = blocks[next++];
+        end = cursor + blockNodes;
+    }
+};
+
+#endif
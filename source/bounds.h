@@ -0,0 +1,103 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "../glm/glm/glm.hpp"
+#include "parallel.h"
+#include "voxelkey.h"
+
+#include <cfloat>
+#include <vector>
+
+// axis-aligned bounding box of a cloud, the pass the octree fits its root with.
+// NaN and infinite coordinates are skipped rather than spreading into the result; a
+// parser hands out +-inf for a number that overflows, and one would make the root
+// infinite.
+
+inline void boundsScalar(const glm::vec3* points, size_t count, glm::vec3& min, glm::vec3& max)
+{
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3& p = points[i];
+        if (p.x < min.x && p.x >= -FLT_MAX)
+            min.x = p.x;
+        if (p.y < min.y && p.y >= -FLT_MAX)
+            min.y = p.y;
+        if (p.z < min.z && p.z >= -FLT_MAX)
+            min.z = p.z;
+        if (p.x > max.x && p.x <= FLT_MAX)
+            max.x = p.x;
+        if (p.y > max.y && p.y <= FLT_MAX)
+            max.y = p.y;
+        if (p.z > max.z && p.z <= FLT_MAX)
+            max.z = p.z;
+    }
+}
+
+#if defined(VOXELKEY_X86)
+// 8 points are 24 floats, three registers whose lanes always hold the same axes
+// (xyzxyzxy, zxyzxyzx, yzxyzxyz), so every lane keeps a running min / max of one axis
+// and the axes are only sorted out at the end. min_ps(v, acc) returns acc when v is
+// NaN, which is what keeps NaNs out; infinities are made NaN first (all bits set) so
+// they are kept out the same way.
+__attribute__((target("avx2"))) inline void boundsAVX2(const glm::vec3* points, size_t count, glm::vec3& min, glm::vec3& max)
+{
+    __m256 lo[3], hi[3];
+    for (int r = 0; r < 3; r++) {
+        lo[r] = _mm256_set1_ps(FLT_MAX);
+        hi[r] = _mm256_set1_ps(-FLT_MAX);
+    }
+    const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 largest = _mm256_set1_ps(FLT_MAX);
+    const float* base = &points[0].x;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int r = 0; r < 3; r++) {
+            __m256 v = _mm256_loadu_ps(base + i * 3 + r * 8);
+            v = _mm256_or_ps(v, _mm256_cmp_ps(_mm256_and_ps(v, magnitude), largest, _CMP_GT_OQ));
+            lo[r] = _mm256_min_ps(v, lo[r]);
+            hi[r] = _mm256_max_ps(v, hi[r]);
+        }
+    }
+    float l[24], h[24];
+    for (int r = 0; r < 3; r++) {
+        _mm256_storeu_ps(l + r * 8, lo[r]);
+        _mm256_storeu_ps(h + r * 8, hi[r]);
+    }
+    // float k of a 24-float block belongs to axis k % 3
+    for (int k = 0; k < 24; k++) {
+        if (l[k] < min[k % 3])
+            min[k % 3] = l[k];
+        if (h[k] > max[k % 3])
+            max[k % 3] = h[k];
+    }
+    boundsScalar(points + i, count - i, min, max);
+}
+#endif
+
+// false for an empty cloud; min and max are left as they were then
+inline bool boundsOf(const glm::vec3* points, size_t count, glm::vec3& min, glm::vec3& max, unsigned int threads = 0)
+{
+    if (count == 0)
+        return false;
+    if (threads == 0)
+        threads = workerCount();
+    // one slice per thread, reduced in slice order
+    std::vector<glm::vec3> mins(threads, glm::vec3(FLT_MAX)), maxs(threads, glm::vec3(-FLT_MAX));
+    parallelFor(count, threads, [&](unsigned int t, size_t begin, size_t end) {
+#if defined(VOXELKEY_X86)
+        if (hasVectorCodec()) {
+            boundsAVX2(points + begin, end - begin, mins[t], maxs[t]);
+            return;
+        }
+#endif
+        boundsScalar(points + begin, end - begin, mins[t], maxs[t]);
+    });
+    min = glm::vec3(FLT_MAX);
+    max = glm::vec3(-FLT_MAX);
+    for (unsigned int t = 0; t < threads; t++) {
+        min = glm::min(min, mins[t]);
+        max = glm::max(max, maxs[t]);
+    }
+    return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef CLOUDFILE_H
+#define CLOUDFILE_H
+
+#include "../glm/glm/glm.hpp"
+#include "loader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// native binary point cloud (.pcld)
+//   CloudHeader (64 bytes, little-endian)
+//   Count * float32 x y z, tightly packed
+// the payload has exactly the layout of std::vector<glm::vec3>, so loading is a memcpy
+// out of the mapping (or a glBufferData straight from it).
+
+const char CLOUD_MAGIC[4] = { 'P', 'C', 'L', 'D' };
+const uint32_t CLOUD_VERSION = 1;
+
+struct CloudHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint64_t Count;
+    float Min[3];
+    float Max[3];
+    float VoxelSize;
+    uint32_t HeaderSize;
+    uint8_t Reserved[16];
+};
+static_assert(sizeof(CloudHeader) == 64, "CloudHeader must stay 64 bytes");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+
+inline bool hasCloudExtension(const std::string& filename)
+{
+    return hasExtension(filename, ".pcld");
+}
+
+// voxelSize is informational, 0 means "raw, not downsampled"
+inline bool writeCloudFile(const std::string& filename, const std::vector<glm::vec3>& vertices, float voxelSize = 0.0f)
+{
+    CloudHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, CLOUD_MAGIC, 4);
+    header.Version = CLOUD_VERSION;
+    header.Count = vertices.size();
+    header.VoxelSize = voxelSize;
+    header.HeaderSize = sizeof(CloudHeader);
+
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (const auto& v : vertices) {
+        min = glm::min(min, v);
+        max = glm::max(max, v);
+    }
+    if (vertices.empty())
+        min = max = glm::vec3(0.0f);
+    for (int i = 0; i < 3; i++) {
+        header.Min[i] = min[i];
+        header.Max[i] = max[i];
+    }
+
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == nullptr) {
+        std::cout << "Failed to open file for writing: " << filename << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (ok && !vertices.empty())
+        ok = fwrite(vertices.data(), sizeof(glm::vec3), vertices.size(), fp) == vertices.size();
+    fclose(fp);
+
+    if (!ok)
+        std::cout << "Failed to write file: " << filename << std::endl;
+    return ok;
+}
+
+// mapped .pcld file; Points points into the mapping and lives as long as this object
+class CloudFile
+{
+public:
+    CloudHeader Header;
+    const glm::vec3* Points = nullptr;
+
+    CloudFile(const std::string& filename) : file(filename)
+    {
+        memset(&Header, 0, sizeof(Header));
+        if (!file.isOpen()) {
+            std::cout << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        if (file.Size < sizeof(CloudHeader)) {
+            std::cout << "Not a point cloud file: " << filename << std::endl;
+            return;
+        }
+        memcpy(&Header, file.Data, sizeof(CloudHeader));
+        if (memcmp(Header.Magic, CLOUD_MAGIC, 4) != 0) {
+            std::cout << "Not a point cloud file: " << filename << std::endl;
+            return;
+        }
+        if (Header.Version > CLOUD_VERSION) {
+            std::cout << "Unsupported point cloud version " << Header.Version << ": " << filename << std::endl;
+            return;
+        }
+        // a zeroed version, a header that does not fit the file or one that misaligns the
+        // payload is corrupt; the size test has to come first, file.Size - HeaderSize
+        // would wrap around
+        if (Header.Version == 0 || Header.HeaderSize < sizeof(CloudHeader) ||
+            Header.HeaderSize % alignof(glm::vec3) != 0) {
+            std::cout << "Corrupt point cloud header: " << filename << std::endl;
+            return;
+        }
+        if (Header.HeaderSize > file.Size ||
+            (file.Size - Header.HeaderSize) / sizeof(glm::vec3) < Header.Count) {
+            std::cout << "Truncated point cloud file: " << filename << std::endl;
+            return;
+        }
+        Points = reinterpret_cast<const glm::vec3*>(file.Data + Header.HeaderSize);
+    }
+
+    bool isOpen() const {
+        return Points != nullptr;
+    }
+
+    size_t count() const {
+        return isOpen() ? static_cast<size_t>(Header.Count) : 0;
+    }
+
+    glm::vec3 getMin() const {
+        return glm::vec3(Header.Min[0], Header.Min[1], Header.Min[2]);
+    }
+
+    glm::vec3 getMax() const {
+        return glm::vec3(Header.Max[0], Header.Max[1], Header.Max[2]);
+    }
+
+private:
+    MappedFile file;
+};
+
+inline void readCloudFile(const std::string& filename, std::vector<glm::vec3>& vertices)
+{
+    CloudFile cloud(filename);
+    if (!cloud.isOpen())
+        return;
+    vertices.insert(vertices.end(), cloud.Points, cloud.Points + cloud.count());
+}
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef COMPACTOCTREE_H
+#define COMPACTOCTREE_H
+
+#include "../glm/glm/glm.hpp"
+#include "octree.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+// what the test handed to CompactOctree::traverse says about a subtree: skip it, look
+// at its children, or take every leaf in it without further tests
+const int COMPACT_SKIP = 0;
+const int COMPACT_DESCEND = 1;
+const int COMPACT_ALL = 2;
+
+// one node of a CompactOctree: which children exist, and where the first of them is.
+// the children of a node are stored next to each other in code order, so child code
+// sits at FirstChild + (number of set bits in ChildMask below code).
+struct CompactOctreeNode
+{
+    uint32_t FirstChild;
+    uint8_t ChildMask;
+};
+
+// read-only copy of an Octree without pointers, centres or sizes. nodes are stored
+// breadth first in one array, so the top levels share a handful of cache lines and
+// siblings are always adjacent. centre and size of a node are recomputed on the way
+// down with the same arithmetic Octree::insertLeaf uses, so positions match exactly.
+// 8 bytes per node against 88 for OctreeNode.
+// indexLeaves() adds, for box queries that take large subtrees whole, the leaf centres
+// and each node's first leaf: each level of a breadth-first array is also in
+// depth-first order, so the leaves of any subtree are one run of Leaves, copied out in
+// one go. that costs 4 bytes per node and 12 per leaf, so it is left to the caller.
+class CompactOctree
+{
+public:
+    std::vector<CompactOctreeNode> Nodes;
+    // filled by indexLeaves(): leaf centres in Octree::octreeToVector order, and where
+    // the run of Nodes[i]'s leaves starts
+    std::vector<glm::vec3> Leaves;
+    std::vector<uint32_t> FirstLeaf;
+
+    size_t size() const {
+        return Nodes.size();
+    }
+
+    unsigned int getLeafCount() const {
+        return LeafCount;
+    }
+
+    void clear() {
+        Nodes.clear();
+        Leaves.clear();
+        FirstLeaf.clear();
+        LeafCount = 0;
+    }
+
+    size_t memoryBytes() const {
+        return Nodes.capacity() * sizeof(CompactOctreeNode) + Leaves.capacity() * sizeof(glm::vec3) +
+            FirstLeaf.capacity() * sizeof(uint32_t);
+    }
+
+    // drops the leaf index; call indexLeaves() again for it
+    void build(Octree& octree) {
+        Nodes.clear();
+        Leaves.clear();
+        FirstLeaf.clear();
+        MaxDepth = octree.getMaxDepth();
+        RootSize = octree.getRootSize();
+        RootCentre = octree.getRootCentre();
+        LeafCount = octree.getLeafCount();
+
+        // queue[i] becomes Nodes[i]; a node's children are queued together,
+        // right after everything already queued, which is exactly where FirstChild points
+        std::vector<OctreeNode*> queue;
+        queue.reserve(octree.getNodeCount());
+        queue.push_back(octree.getRoot());
+        Nodes.reserve(octree.getNodeCount());
+        for (size_t i = 0; i < queue.size(); i++) {
+            CompactOctreeNode node;
+            node.FirstChild = static_cast<uint32_t>(queue.size());
+            node.ChildMask = 0;
+            for (unsigned int code = 0; code < 8; code++) {
+                if (queue[i]->Children[code] != nullptr) {
+                    node.ChildMask |= 1 << code;
+                    queue.push_back(queue[i]->Children[code]);
+                }
+            }
+            Nodes.push_back(node);
+        }
+    }
+
+    // builds Leaves and FirstLeaf, which findInBox and findInSlab then use to take a
+    // subtree inside the box in one copy instead of walking it
+    void indexLeaves() {
+        Leaves.clear();
+        Leaves.reserve(LeafCount);
+        toVector(Leaves);
+        // leaves are the nodes of depth MaxDepth, numbered by their rank in Nodes. a
+        // node's first leaf is its first child's, and a node without children owns an
+        // empty run at the end; children sit after their parent, so a backward pass does
+        std::vector<uint8_t> depth(Nodes.size(), 0);
+        for (size_t i = 0; i < Nodes.size(); i++) {
+            uint32_t children = __builtin_popcount(Nodes[i].ChildMask);
+            for (uint32_t c = 0; c < children; c++)
+                depth[Nodes[i].FirstChild + c] = depth[i] + 1;
+        }
+        FirstLeaf.assign(Nodes.size(), 0);
+        uint32_t rank = 0;
+        for (size_t i = 0; i < Nodes.size(); i++) {
+            if (depth[i] >= MaxDepth)
+                FirstLeaf[i] = rank++;
+        }
+        for (size_t i = Nodes.size(); i-- > 0;) {
+            if (depth[i] >= MaxDepth)
+                continue;
+            FirstLeaf[i] = Nodes[i].ChildMask ? FirstLeaf[Nodes[i].FirstChild] : static_cast<uint32_t>(Leaves.size());
+        }
+    }
+
+    // true if the point's leaf exists; same descent and bounds as Octree::insertLeaf
+    bool contains(const glm::vec3& point) const {
+        if (Nodes.empty())
+            return false;
+        if (!Octree::encloses(RootCentre, RootSize, point))
+            return false;
+        glm::vec3 c = RootCentre;
+        float l = RootSize;
+
+        uint32_t index = 0;
+        for (unsigned int depth = 0; depth < MaxDepth; depth++) {
+            unsigned int code = 0;
+            if (point.x >= c.x)
+                code |= 1;
+            if (point.y >= c.y)
+                code |= 2;
+            if (point.z >= c.z)
+                code |= 4;
+            const CompactOctreeNode& node = Nodes[index];
+            if ((node.ChildMask & (1 << code)) == 0)
+                return false;
+            index = childIndex(node, code);
+            l *= 0.5f;
+            c += OffsetTable[code] * l * 0.5f;
+        }
+        return true;
+    }
+
+    // leaf centres in the order Octree::octreeToVector gives them
+    void toVector(std::vector<glm::vec3>& points) const {
+        traverse([](const glm::vec3&, float) { return true; }, points);
+    }
+
+    // same slab test as Octree::findByY
+    void findByY(float y, std::vector<glm::vec3>& points) const {
+        traverse([y](const glm::vec3& c, float l) {
+            return !(y < c.y - l * 1.0f || c.y + l * 1.0f < y);
+        }, points);
+    }
+
+    // same leaves and order as Octree::findInSlab
+    void findInSlab(float yMin, float yMax, std::vector<glm::vec3>& points) const {
+        findInBox(glm::vec3(-FLT_MAX, yMin, -FLT_MAX), glm::vec3(FLT_MAX, yMax, FLT_MAX), points);
+    }
+
+    // same leaves and order as Octree::findInBox
+    void findInBox(const glm::vec3& min, const glm::vec3& max, std::vector<glm::vec3>& points) const {
+        // half a leaf
+        float inset = RootSize * 0.5f;
+        for (unsigned int d = 0; d < MaxDepth; d++)
+            inset *= 0.5f;
+        traverse([&](const glm::vec3& c, float l) {
+            float reach = l * 0.5f - inset;
+            glm::vec3 lo = c - glm::vec3(reach);
+            glm::vec3 hi = c + glm::vec3(reach);
+            if (hi.x < min.x || hi.y < min.y || hi.z < min.z ||
+                lo.x > max.x || lo.y > max.y || lo.z > max.z)
+                return COMPACT_SKIP;
+            if (lo.x >= min.x && lo.y >= min.y && lo.z >= min.z &&
+                hi.x <= max.x && hi.y <= max.y && hi.z <= max.z)
+                return COMPACT_ALL;
+            return COMPACT_DESCEND;
+        }, points);
+    }
+
+private:
+    unsigned int MaxDepth = 0;
+    float RootSize = 0.0f;
+    glm::vec3 RootCentre;
+    unsigned int LeafCount = 0;
+
+    struct Visit
+    {
+        uint32_t Index;
+        unsigned int Depth;
+        glm::vec3 c;
+        float l;
+        // inside a subtree taken whole, where keep is not asked any more
+        bool All;
+    };
+
+    static uint32_t childIndex(const CompactOctreeNode& node, unsigned int code) {
+        return node.FirstChild + __builtin_popcount(node.ChildMask & ((1u << code) - 1));
+    }
+
+    // one past the last leaf under Nodes[index]. the next node is either the next one on
+    // the same level, whose leaves start where these end, or the first of the level
+    // below, whose leaves start at 0 and mark index as the last of its level
+    uint32_t leafEnd(uint32_t index) const {
+        if (index + 1 < Nodes.size() && FirstLeaf[index + 1] > FirstLeaf[index])
+            return FirstLeaf[index + 1];
+        return static_cast<uint32_t>(Leaves.size());
+    }
+
+    // depth first, children in code order. keep(centre, size) is asked about every node
+    // and answers COMPACT_SKIP, COMPACT_DESCEND or COMPACT_ALL (a bool is skip or
+    // descend); a subtree taken whole is one copy out of Leaves after indexLeaves(),
+    // and a walk without further tests before. leaves reached are appended to points
+    template <typename F>
+    void traverse(F keep, std::vector<glm::vec3>& points) const {
+        if (Nodes.empty())
+            return;
+        std::vector<Visit> stack;
+        stack.push_back({ 0, 0, RootCentre, RootSize, false });
+        while (!stack.empty()) {
+            Visit visit = stack.back();
+            stack.pop_back();
+            if (!visit.All) {
+                int verdict = keep(visit.c, visit.l);
+                if (verdict == COMPACT_SKIP)
+                    continue;
+                if (verdict == COMPACT_ALL) {
+                    if (!FirstLeaf.empty()) {
+                        points.insert(points.end(), Leaves.begin() + FirstLeaf[visit.Index], Leaves.begin() + leafEnd(visit.Index));
+                        continue;
+                    }
+                    visit.All = true;
+                }
+            }
+            if (visit.Depth >= MaxDepth) {
+                points.push_back(visit.c);
+                continue;
+            }
+            const CompactOctreeNode& node = Nodes[visit.Index];
+            float newBoxsize = 0.5f * visit.l;
+            // pushed last to first so they come off the stack in code order
+            for (int code = 7; code >= 0; code--) {
+                if (node.ChildMask & (1 << code)) {
+                    glm::vec3 offset = OffsetTable[code] * newBoxsize * 0.5f;
+                    stack.push_back({ childIndex(node, code), visit.Depth + 1, visit.c + offset, newBoxsize, visit.All });
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef HASHGRID_H
+#define HASHGRID_H
+
+#include "../glm/glm/glm.hpp"
+#include "voxelkey.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+const uint64_t HASHGRID_EMPTY = ~0ull;
+// keys encoded per batch insert, small enough to stay in L1
+const size_t HASHGRID_BATCH = 1024;
+
+// voxel set on a flat open-addressing table (linear probing), the cache-friendly
+// replacement for the old std::unordered_map downsampler. keys are VoxelKey values,
+// so negative coordinates do not spill into the neighbouring field.
+class VoxelHashGrid
+{
+public:
+    // voxel centres in the order they were first seen
+    std::vector<glm::vec3> Voxels;
+
+    VoxelHashGrid(float voxelSize = 1.0f, size_t expected = 1024)
+    {
+        VoxelSize = voxelSize;
+        size_t n = 16;
+        while (n < expected * 2)
+            n <<= 1;
+        slots.assign(n, HASHGRID_EMPTY);
+        indices.resize(n);
+    }
+
+    float getVoxelSize() const {
+        return VoxelSize;
+    }
+
+    size_t size() const {
+        return Voxels.size();
+    }
+
+    void clear() {
+        Voxels.clear();
+        std::fill(slots.begin(), slots.end(), HASHGRID_EMPTY);
+    }
+
+    uint64_t keyOf(const glm::vec3& point) const {
+        return VoxelKey::fromPoint(point, VoxelSize).Value;
+    }
+
+    // index of the point's voxel in Voxels, creating the voxel if needed
+    size_t indexOf(const glm::vec3& point, bool& inserted) {
+        return indexOfKey(keyOf(point), inserted);
+    }
+
+    // same for a key from encodeVoxelKeys
+    size_t indexOfKey(uint64_t key, bool& inserted) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i] == key) {
+                inserted = false;
+                return indices[i];
+            }
+            if (slots[i] == HASHGRID_EMPTY) {
+                size_t index = Voxels.size();
+                slots[i] = key;
+                indices[i] = static_cast<uint32_t>(index);
+                Voxels.push_back(VoxelKey(key).centre(VoxelSize));
+                if (Voxels.size() * 2 > slots.size())
+                    grow();
+                inserted = true;
+                return index;
+            }
+        }
+    }
+
+    // returns true if the point opened a new voxel
+    bool insert(const glm::vec3& point) {
+        bool inserted;
+        indexOf(point, inserted);
+        return inserted;
+    }
+
+    // keys are encoded a batch at a time with the vector codec, then probed one by one
+    void insert(const glm::vec3* points, size_t count) {
+        uint64_t keys[HASHGRID_BATCH];
+        for (size_t first = 0; first < count; first += HASHGRID_BATCH) {
+            size_t n = std::min(HASHGRID_BATCH, count - first);
+            encodeVoxelKeys(points + first, n, VoxelSize, keys);
+            bool inserted;
+            for (size_t i = 0; i < n; i++)
+                indexOfKey(keys[i], inserted);
+        }
+    }
+
+    // index of the point's voxel in Voxels, or SIZE_MAX if it has none
+    size_t find(const glm::vec3& point) const {
+        return findKey(keyOf(point));
+    }
+
+    size_t findKey(uint64_t key) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i] == key)
+                return indices[i];
+            if (slots[i] == HASHGRID_EMPTY)
+                return SIZE_MAX;
+        }
+    }
+
+    bool contains(const glm::vec3& point) const {
+        return find(point) != SIZE_MAX;
+    }
+
+    // append every key in the table, in slot order
+    void keys(std::vector<uint64_t>& out) const {
+        out.reserve(out.size() + Voxels.size());
+        for (uint64_t key : slots) {
+            if (key != HASHGRID_EMPTY)
+                out.push_back(key);
+        }
+    }
+
+    // voxels whose slab contains y, same test findByY does at leaf level
+    void findByY(float y, std::vector<glm::vec3>& points) const {
+        for (const auto& v : Voxels) {
+            if (y >= v.y - VoxelSize && y <= v.y + VoxelSize)
+                points.push_back(v);
+        }
+    }
+
+private:
+    float VoxelSize;
+    std::vector<uint64_t> slots;
+    // position in Voxels of the key in the same slot
+    std::vector<uint32_t> indices;
+
+    static size_t hash(uint64_t key) {
+        // a multiply alone never carries the x field (bits 42 and up) down into the low
+        // bits the table is indexed by, so fold the high half in first (murmur3 finaliser)
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+
+    void grow() {
+        std::vector<uint64_t> oldSlots;
+        std::vector<uint32_t> oldIndices;
+        oldSlots.swap(slots);
+        oldIndices.swap(indices);
+        slots.assign(oldSlots.size() * 2, HASHGRID_EMPTY);
+        indices.resize(slots.size());
+        size_t mask = slots.size() - 1;
+        for (size_t k = 0; k < oldSlots.size(); k++) {
+            if (oldSlots[k] == HASHGRID_EMPTY)
+                continue;
+            size_t i = hash(oldSlots[k]) & mask;
+            while (slots[i] != HASHGRID_EMPTY)
+                i = (i + 1) & mask;
+            slots[i] = oldSlots[k];
+            indices[i] = oldIndices[k];
+        }
+    }
+};
+
+#endif
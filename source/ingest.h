@@ -0,0 +1,200 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "../glm/glm/glm.hpp"
+#include "ringbuffer.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// live point batches over a UNIX domain stream socket.
+// every batch is a BatchHeader followed by Count packed float32 x y z.
+
+const char BATCH_MAGIC[4] = { 'P', 'B', 'A', 'T' };
+const uint32_t MAX_BATCH_POINTS = 1 << 24;
+
+struct BatchHeader
+{
+    char Magic[4];
+    uint32_t Count;
+};
+
+// write exactly size bytes, false on error or hang-up
+inline bool sendAll(int fd, const void* data, size_t size)
+{
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool isSocketPath(const std::string& path)
+{
+    return path.compare(0, 5, "unix:") == 0;
+}
+
+inline bool sendBatch(int fd, const glm::vec3* points, uint32_t count)
+{
+    BatchHeader header;
+    memcpy(header.Magic, BATCH_MAGIC, 4);
+    header.Count = count;
+    return sendAll(fd, &header, sizeof(header)) && sendAll(fd, points, count * sizeof(glm::vec3));
+}
+
+inline int connectSocket(const std::string& path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// listens on a socket path and moves incoming points into a lock-free ring.
+// all I/O happens on the receiver thread; the render loop only ever calls drain().
+class SocketIngest
+{
+public:
+    SocketIngest(const std::string& path, size_t ringCapacity = 1 << 22) : Path(path), ring(ringCapacity) {}
+    ~SocketIngest()
+    {
+        stop();
+    }
+
+    std::string Path;
+    // points received so far
+    std::atomic<uint64_t> Received{ 0 };
+
+    bool start() {
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+            std::cout << "Failed to create socket" << std::endl;
+            return false;
+        }
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, Path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(Path.c_str());
+        if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+            std::cout << "Failed to listen on socket: " << Path << std::endl;
+            close(listener);
+            listener = -1;
+            return false;
+        }
+        running = true;
+        worker = std::thread(&SocketIngest::run, this);
+        return true;
+    }
+
+    void stop() {
+        running = false;
+        if (worker.joinable())
+            worker.join();
+        if (listener >= 0) {
+            close(listener);
+            unlink(Path.c_str());
+            listener = -1;
+        }
+    }
+
+    // consumer: append up to maxPoints waiting points to out, never blocks. only what
+    // was popped is appended, so a vector kept across frames does not reallocate
+    size_t drain(std::vector<glm::vec3>& out, size_t maxPoints) {
+        return ring.pop(out, maxPoints);
+    }
+
+private:
+    SPSCRing<glm::vec3> ring;
+    int listener = -1;
+    std::atomic<bool> running{ false };
+    std::thread worker;
+
+    // wait for fd to become readable, giving up every 100 ms to check for stop()
+    bool waitReadable(int fd) {
+        while (running) {
+            pollfd pfd = { fd, POLLIN, 0 };
+            int r = poll(&pfd, 1, 100);
+            if (r > 0)
+                return true;
+            if (r < 0)
+                return false;
+        }
+        return false;
+    }
+
+    // read exactly size bytes, false on error, hang-up or stop(). every read waits in
+    // waitReadable first, so a client that stalls mid-batch can not block stop()
+    bool receiveAll(int fd, void* data, size_t size) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            if (!waitReadable(fd))
+                return false;
+            ssize_t n = recv(fd, p, size, 0);
+            if (n <= 0)
+                return false;
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    void run() {
+        std::vector<glm::vec3> batch;
+        while (running) {
+            if (!waitReadable(listener))
+                continue;
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0)
+                continue;
+
+            while (running && waitReadable(client)) {
+                BatchHeader header;
+                if (!receiveAll(client, &header, sizeof(header)))
+                    break;
+                if (memcmp(header.Magic, BATCH_MAGIC, 4) != 0 || header.Count > MAX_BATCH_POINTS) {
+                    std::cout << "Bad batch on " << Path << ", dropping client" << std::endl;
+                    break;
+                }
+                batch.resize(header.Count);
+                if (!receiveAll(client, batch.data(), header.Count * sizeof(glm::vec3)))
+                    break;
+
+                // a full ring means the renderer is behind: back-pressure the socket, not the frame
+                size_t pushed = 0;
+                while (running && pushed < batch.size()) {
+                    pushed += ring.push(batch.data() + pushed, batch.size() - pushed);
+                    if (pushed < batch.size())
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                Received += batch.size();
+            }
+            close(client);
+        }
+    }
+};
+
+#endif
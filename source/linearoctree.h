@@ -0,0 +1,327 @@
+#ifndef LINEAROCTREE_H
+#define LINEAROCTREE_H
+
+#include "../glm/glm/glm.hpp"
+#include "morton.h"
+#include "octree.h"
+#include "voxelkey.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// locational codes: a node at depth d is the sentinel bit 1 << 3d followed by its d child
+// codes from the root down, so codes of different levels never collide, the root is 1
+// and 0 is free to mean "no node"
+const uint64_t LINEAROCTREE_ROOT = 1;
+const uint64_t LINEAROCTREE_NONE = 0;
+// keys computed per batch by the batch insert and lookup
+const size_t LINEAROCTREE_BATCH = 1024;
+
+#if defined(VOXELKEY_X86)
+// LinearOctree::keyOf for a run of points with the interleave done by pdep; the grid
+// index arithmetic is the scalar one, so the keys are identical
+__attribute__((target("avx2,bmi2"))) inline void linearOctreeKeysBMI2(const glm::vec3* points, size_t count,
+    const glm::vec3& centre, float rootSize, double leafScale, unsigned int maxDepth, uint64_t* keys)
+{
+    const float _hl = rootSize * 0.5f;
+    const glm::vec3 lo = centre - glm::vec3(_hl), hi = centre + glm::vec3(_hl);
+    const double low[3] = { static_cast<double>(centre.x) - 0.5 * rootSize,
+        static_cast<double>(centre.y) - 0.5 * rootSize, static_cast<double>(centre.z) - 0.5 * rootSize };
+    const uint64_t sentinel = 1ull << (3 * maxDepth);
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3& p = points[i];
+        // Octree::encloses
+        if (p.x < lo.x || p.x >= hi.x || p.y < lo.y || p.y >= hi.y || p.z < lo.z || p.z >= hi.z) {
+            keys[i] = LINEAROCTREE_NONE;
+            continue;
+        }
+        keys[i] = sentinel | _pdep_u64(octreeGridIndex(p.x, low[0], leafScale, maxDepth), MORTON_X_BITS) |
+            _pdep_u64(octreeGridIndex(p.y, low[1], leafScale, maxDepth), MORTON_X_BITS << 1) |
+            _pdep_u64(octreeGridIndex(p.z, low[2], leafScale, maxDepth), MORTON_X_BITS << 2);
+    }
+}
+#endif
+
+// octree without pointers: every node, leaves and all their ancestors, sits in one flat
+// hash table under its locational code. a leaf is found by hashing its code instead of
+// walking down from the root, its parent is the code shifted right by one triple, and a
+// neighbour is the code with its coordinates moved by one, each a single probe. codes and
+// child masks are separate arrays so probing only streams through the codes.
+// same geometry and face rule as Octree, so both put a point in the same leaf. the root
+// starts as a maxSize cube around the origin; fit() moves it onto the data.
+class LinearOctree
+{
+public:
+    LinearOctree(float voxelSize = 1.0f, float maxSize = 256.0f, size_t expected = 1024)
+    {
+        MaxDepth = 0;
+        while (voxelSize * 2.0f <= maxSize) {
+            voxelSize *= 2.0f;
+            MaxDepth++;
+        }
+        RootSize = voxelSize;
+        RootCentre = glm::vec3(0.0f, 0.0f, 0.0f);
+        LeafScale = static_cast<double>(1u << MaxDepth) / RootSize;
+        size_t n = 16;
+        while (n < expected * 2)
+            n <<= 1;
+        slots.assign(n, LINEAROCTREE_NONE);
+        masks.assign(n, 0);
+    }
+
+    unsigned int getMaxDepth() const {
+        return MaxDepth;
+    }
+
+    float getRootSize() const {
+        return RootSize;
+    }
+
+    const glm::vec3& getRootCentre() const {
+        return RootCentre;
+    }
+
+    // nodes of every level
+    size_t size() const {
+        return count;
+    }
+
+    size_t getLeafCount() const {
+        return leafCount;
+    }
+
+    size_t memoryBytes() const {
+        return slots.size() * (sizeof(uint64_t) + sizeof(uint8_t));
+    }
+
+    void clear() {
+        std::fill(slots.begin(), slots.end(), LINEAROCTREE_NONE);
+        std::fill(masks.begin(), masks.end(), 0);
+        count = 0;
+        leafCount = 0;
+    }
+
+    // empty the tree and make the root the smallest cube of leafSize * 2^n that covers
+    // [min, max], on the leaf lattice as Octree::fit() puts it, so both still agree
+    void fit(const glm::vec3& min, const glm::vec3& max) {
+        const float leafSize = RootSize / static_cast<float>(1u << MaxDepth);
+        glm::vec3 low = glm::floor(min / leafSize) * leafSize;
+        glm::vec3 extent = max - low;
+        float reach = std::max(extent.x, std::max(extent.y, extent.z));
+        MaxDepth = 1;
+        RootSize = leafSize * 2.0f;
+        while (RootSize <= reach && MaxDepth < OCTREE_MAX_DEPTH) {
+            RootSize *= 2.0f;
+            MaxDepth++;
+        }
+        RootCentre = low + glm::vec3(RootSize * 0.5f);
+        LeafScale = static_cast<double>(1u << MaxDepth) / RootSize;
+        clear();
+    }
+
+    // code of the point's leaf, or LINEAROCTREE_NONE outside the root
+    uint64_t keyOf(const glm::vec3& point) const {
+        if (!Octree::encloses(RootCentre, RootSize, point))
+            return LINEAROCTREE_NONE;
+        uint64_t morton = mortonEncode(octreeGridIndex(point.x, lowOf(0), LeafScale, MaxDepth),
+            octreeGridIndex(point.y, lowOf(1), LeafScale, MaxDepth),
+            octreeGridIndex(point.z, lowOf(2), LeafScale, MaxDepth), 0);
+        return (1ull << (3 * MaxDepth)) | morton;
+    }
+
+    // keyOf for count points
+    void keysOf(const glm::vec3* points, size_t count, uint64_t* keys) const {
+#if defined(VOXELKEY_X86)
+        if (hasVectorCodec()) {
+            linearOctreeKeysBMI2(points, count, RootCentre, RootSize, LeafScale, MaxDepth, keys);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < count; i++)
+            keys[i] = keyOf(points[i]);
+    }
+
+    static unsigned int depthOf(uint64_t key) {
+        return (63 - __builtin_clzll(key)) / 3;
+    }
+
+    // LINEAROCTREE_NONE for the root
+    static uint64_t parentOf(uint64_t key) {
+        return key >> 3;
+    }
+
+    static uint64_t childOf(uint64_t key, unsigned int code) {
+        return (key << 3) | code;
+    }
+
+    // code of the node next to key on the same level, dx, dy, dz cells away, or
+    // LINEAROCTREE_NONE if that lies outside the root. the node itself need not exist.
+    uint64_t neighbourOf(uint64_t key, int dx, int dy, int dz) const {
+        unsigned int depth = depthOf(key);
+        int x, y, z;
+        mortonDecode(key ^ (1ull << (3 * depth)), x, y, z, 0);
+        x += dx;
+        y += dy;
+        z += dz;
+        const int cells = 1 << depth;
+        if (x < 0 || y < 0 || z < 0 || x >= cells || y >= cells || z >= cells)
+            return LINEAROCTREE_NONE;
+        return (1ull << (3 * depth)) | mortonEncode(x, y, z, 0);
+    }
+
+    float sizeOf(uint64_t key) const {
+        float l = RootSize;
+        for (unsigned int d = depthOf(key); d > 0; d--)
+            l *= 0.5f;
+        return l;
+    }
+
+    glm::vec3 centreOf(uint64_t key) const {
+        unsigned int depth = depthOf(key);
+        int x, y, z;
+        mortonDecode(key ^ (1ull << (3 * depth)), x, y, z, 0);
+        float l = sizeOf(key);
+        return glm::vec3(x + 0.5f, y + 0.5f, z + 0.5f) * l + RootCentre - glm::vec3(RootSize * 0.5f);
+    }
+
+    // slot of the node, for childMask(), or SIZE_MAX if there is none
+    size_t find(uint64_t key) const {
+        if (key == LINEAROCTREE_NONE)
+            return SIZE_MAX;
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i] == key)
+                return i;
+            if (slots[i] == LINEAROCTREE_NONE)
+                return SIZE_MAX;
+        }
+    }
+
+    // which of the node's children exist, bit code set for child code; 0 for a leaf
+    uint8_t childMask(size_t slot) const {
+        return masks[slot];
+    }
+
+    bool contains(uint64_t key) const {
+        return find(key) != SIZE_MAX;
+    }
+
+    bool contains(const glm::vec3& point) const {
+        return find(keyOf(point)) != SIZE_MAX;
+    }
+
+    // found[i] = contains(points[i])
+    void contains(const glm::vec3* points, size_t count, uint8_t* found) const {
+        uint64_t keys[LINEAROCTREE_BATCH];
+        for (size_t first = 0; first < count; first += LINEAROCTREE_BATCH) {
+            size_t n = std::min(LINEAROCTREE_BATCH, count - first);
+            keysOf(points + first, n, keys);
+            for (size_t i = 0; i < n; i++)
+                found[first + i] = find(keys[i]) != SIZE_MAX;
+        }
+    }
+
+    // adds a leaf code and whatever ancestors it is missing; returns true if the leaf is new
+    bool insertKey(uint64_t key) {
+        if (key == LINEAROCTREE_NONE)
+            return false;
+        bool inserted;
+        slotOf(key, inserted);
+        if (!inserted)
+            return false;
+        leafCount++;
+        // up until an ancestor that was already there, which has all of its own
+        for (; key != LINEAROCTREE_ROOT; key >>= 3) {
+            size_t parent = slotOf(key >> 3, inserted);
+            masks[parent] |= static_cast<uint8_t>(1 << (key & 7));
+            if (!inserted)
+                break;
+        }
+        return true;
+    }
+
+    bool insert(const glm::vec3& point) {
+        return insertKey(keyOf(point));
+    }
+
+    // returns how many leaves were new
+    size_t insert(const glm::vec3* points, size_t count) {
+        uint64_t keys[LINEAROCTREE_BATCH];
+        size_t created = 0;
+        for (size_t first = 0; first < count; first += LINEAROCTREE_BATCH) {
+            size_t n = std::min(LINEAROCTREE_BATCH, count - first);
+            keysOf(points + first, n, keys);
+            for (size_t i = 0; i < n; i++)
+                created += insertKey(keys[i]);
+        }
+        return created;
+    }
+
+private:
+    float RootSize;
+    glm::vec3 RootCentre;
+    double LeafScale;
+    unsigned int MaxDepth;
+    std::vector<uint64_t> slots;
+    // child mask of the node in the same slot
+    std::vector<uint8_t> masks;
+    size_t count = 0;
+    size_t leafCount = 0;
+
+    // low face of the root on axis
+    double lowOf(int axis) const {
+        return static_cast<double>(RootCentre[axis]) - 0.5 * RootSize;
+    }
+
+    static size_t hash(uint64_t key) {
+        // same murmur3 finaliser as VoxelHashGrid
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+
+    // slot of key, adding the node if needed. the table grows before the probe, so the
+    // slot stays valid until the next insert
+    size_t slotOf(uint64_t key, bool& inserted) {
+        if ((count + 1) * 2 > slots.size())
+            grow();
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i] == key) {
+                inserted = false;
+                return i;
+            }
+            if (slots[i] == LINEAROCTREE_NONE) {
+                slots[i] = key;
+                masks[i] = 0;
+                count++;
+                inserted = true;
+                return i;
+            }
+        }
+    }
+
+    void grow() {
+        std::vector<uint64_t> oldSlots;
+        std::vector<uint8_t> oldMasks;
+        oldSlots.swap(slots);
+        oldMasks.swap(masks);
+        slots.assign(oldSlots.size() * 2, LINEAROCTREE_NONE);
+        masks.assign(slots.size(), 0);
+        size_t mask = slots.size() - 1;
+        for (size_t k = 0; k < oldSlots.size(); k++) {
+            if (oldSlots[k] == LINEAROCTREE_NONE)
+                continue;
+            size_t i = hash(oldSlots[k]) & mask;
+            while (slots[i] != LINEAROCTREE_NONE)
+                i = (i + 1) & mask;
+            slots[i] = oldSlots[k];
+            masks[i] = oldMasks[k];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "../glm/glm/glm.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+
+// read-only view of a whole file, mapped instead of streamed
+class MappedFile
+{
+public:
+    const char* Data = nullptr;
+    size_t Size = 0;
+
+    MappedFile(const std::string& filename)
+    {
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+            return;
+
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED)
+            return;
+
+        // we only walk the file front to back
+        madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+
+        Data = static_cast<const char*>(ptr);
+        Size = static_cast<size_t>(st.st_size);
+    }
+    ~MappedFile()
+    {
+        if (Data != nullptr)
+            munmap(const_cast<char*>(Data), Size);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool isOpen() const {
+        return Data != nullptr;
+    }
+
+private:
+    int fd = -1;
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+inline bool hasExtension(const std::string& filename, const std::string& ext)
+{
+    return filename.size() >= ext.size() &&
+        filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// locale-free float parser working directly on the mapped bytes.
+// returns the position after the number, or nullptr if there is no number at p.
+inline const char* parseFloat(const char* p, const char* end, float& out)
+{
+    static const double Pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool any = false;
+
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+                digits++;
+        }
+        else {
+            exponent++;
+        }
+        any = true;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+                if (mantissa != 0)
+                    digits++;
+            }
+            any = true;
+            p++;
+        }
+    }
+    if (!any)
+        return nullptr;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool expNegative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            expNegative = (*q == '-');
+            q++;
+        }
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            while (q < end && *q >= '0' && *q <= '9') {
+                if (e < 10000)
+                    e = e * 10 + (*q - '0');
+                q++;
+            }
+            exponent += expNegative ? -e : e;
+            p = q;
+        }
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        while (exponent < -22) {
+            value /= 1e22;
+            exponent += 22;
+        }
+        value /= Pow10[-exponent];
+    }
+    else {
+        while (exponent > 22) {
+            value *= 1e22;
+            exponent -= 22;
+        }
+        value *= Pow10[exponent];
+    }
+
+    out = static_cast<float>(negative ? -value : value);
+    return p;
+}
+
+// parse "x y z" lines in [begin, end) and append them to vertices, stopping early once
+// maxPoints have been added. lines that do not start with three numbers are reported and
+// skipped. returns where parsing stopped.
+inline const char* parseVertices(const char* begin, const char* end, std::vector<glm::vec3>& vertices, size_t maxPoints = SIZE_MAX)
+{
+    const char* p = begin;
+    size_t added = 0;
+    while (p < end && added < maxPoints) {
+        const char* eol = p;
+        while (eol < end && *eol != '\n')
+            eol++;
+
+        float x, y, z;
+        const char* q = parseFloat(p, eol, x);
+        if (q != nullptr)
+            q = parseFloat(q, eol, y);
+        if (q != nullptr)
+            q = parseFloat(q, eol, z);
+
+        if (q != nullptr) {
+            vertices.emplace_back(x, y, z);
+            added++;
+        }
+        else {
+            // keep quiet about blank lines and a trailing '\r'
+            const char* s = p;
+            while (s < eol && (*s == ' ' || *s == '\t' || *s == '\r'))
+                s++;
+            if (s != eol)
+                std::cout << "Failed to read line: " << std::string(p, eol) << std::endl;
+        }
+
+        p = eol + 1;
+    }
+    return p < end ? p : end;
+}
+
+// Put vertices in vertices array from file, parsing straight out of the page cache
+inline void readVerticesMapped(const std::string& filename, std::vector<glm::vec3>& vertices)
+{
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cout << "Failed to open file: " << filename << std::endl;
+        return;
+    }
+
+    // a typical "x y z" line is a little over 24 bytes
+    vertices.reserve(vertices.size() + file.Size / 24);
+    parseVertices(file.Data, file.Data + file.Size, vertices);
+}
+
+// number of worker threads for the parallel loaders
+inline unsigned int loaderThreadCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// parseVertices over [begin, end) cut into newline-aligned chunks that are parsed on all
+// cores. the chunks are concatenated in order, so the result is identical to
+// parseVertices on the whole range.
+inline void parseVerticesParallel(const char* begin, const char* end, std::vector<glm::vec3>& vertices, unsigned int threadCount = 0)
+{
+    const size_t size = static_cast<size_t>(end - begin);
+    if (threadCount == 0)
+        threadCount = loaderThreadCount();
+    // not worth spinning up threads for less than a few MB each
+    const size_t minChunk = 4 << 20;
+    if (size / threadCount < minChunk)
+        threadCount = static_cast<unsigned int>(size / minChunk) + 1;
+    if (threadCount == 1) {
+        parseVertices(begin, end, vertices);
+        return;
+    }
+
+    // chunk i is [bounds[i], bounds[i + 1]), each bound sits just after a '\n'
+    std::vector<const char*> bounds(threadCount + 1, end);
+    bounds[0] = begin;
+    for (unsigned int i = 1; i < threadCount; i++) {
+        const char* p = begin + size / threadCount * i;
+        if (p < bounds[i - 1])
+            p = bounds[i - 1];
+        while (p < end && *p != '\n')
+            p++;
+        bounds[i] = (p < end) ? p + 1 : end;
+    }
+
+    std::vector<std::vector<glm::vec3>> parts(threadCount);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back([&, i]() {
+            parts[i].reserve((bounds[i + 1] - bounds[i]) / 24);
+            parseVertices(bounds[i], bounds[i + 1], parts[i]);
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    // merge into one preallocated vector, each part copied by its own thread
+    size_t base = vertices.size();
+    std::vector<size_t> offsets(threadCount + 1, base);
+    for (unsigned int i = 0; i < threadCount; i++)
+        offsets[i + 1] = offsets[i] + parts[i].size();
+    vertices.resize(offsets[threadCount]);
+
+    workers.clear();
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back([&, i]() {
+            std::copy(parts[i].begin(), parts[i].end(), vertices.begin() + offsets[i]);
+            std::vector<glm::vec3>().swap(parts[i]);
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+}
+
+// same as readVerticesMapped, but parsed on all cores by parseVerticesParallel
+inline void readVerticesParallel(const std::string& filename, std::vector<glm::vec3>& vertices, unsigned int threadCount = 0)
+{
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cout << "Failed to open file: " << filename << std::endl;
+        return;
+    }
+    parseVerticesParallel(file.Data, file.Data + file.Size, vertices, threadCount);
+}
+
+// the original getline/istringstream reader, kept as a reference for the benchmark
+inline void readVerticesStream(const std::string& filename, std::vector<glm::vec3>& vertices)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open file: " << filename << std::endl;
+        return;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        float x, y, z;
+        if (!(iss >> x >> y >> z)) {
+            std::cout << "Failed to read line: " << line << std::endl;
+            continue;
+        }
+
+        vertices.emplace_back(x, y, z);
+    }
+
+    file.close();
+}
+
+#endif
@@ -4,7 +4,10 @@
 #include "../glad.h"
 #include "../glm/glm/glm.hpp"
 #include "../glm/glm/gtc/matrix_transform.hpp"
+#include "shader.h"
+#include "quantized.h"
 
+#include <algorithm>
 #include <vector>
 
 class Point
@@ -15,11 +18,83 @@ public:
     // gl variables
     unsigned int VAO;
     unsigned int VBO;
+    // points the VBO has room for
+    size_t Capacity = 0;
 
     Point(std::vector<glm::vec3> &positions)
     {
         Positions = positions;
+        setup(Positions.data(), Positions.size());
+    }
+
+    // upload straight from caller memory (e.g. a mapped .pcld file)
+    Point(const glm::vec3 *positions, size_t count)
+    {
+        Positions.assign(positions, positions + count);
+        setup(positions, count);
+    }
+
+    // empty cloud with room for capacity points, filled progressively with Append()
+    Point(size_t capacity)
+    {
+        Positions.reserve(capacity);
+        setup(nullptr, capacity);
+    }
+
+    void Refresh()
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, Positions.size() * sizeof(glm::vec3), Positions.data(), GL_STATIC_DRAW);
+        Capacity = Positions.size();
+    }
+
+    // upload only the new range; the buffer doubles when the capacity guess was short
+    void Append(const glm::vec3 *positions, size_t count)
+    {
+        size_t offset = Positions.size();
+        Positions.insert(Positions.end(), positions, positions + count);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (Positions.size() > Capacity) {
+            Capacity = std::max(Capacity * 2, Positions.size());
+            glBufferData(GL_ARRAY_BUFFER, Capacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, Positions.size() * sizeof(glm::vec3), Positions.data());
+        }
+        else {
+            glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(glm::vec3), count * sizeof(glm::vec3), positions);
+        }
+    }
+
+    // take over a whole new frame; the previous positions end up in positions.
+    // orphaning the buffer lets the driver keep drawing the old frame while we upload.
+    void Swap(std::vector<glm::vec3> &positions)
+    {
+        Positions.swap(positions);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (Positions.size() > Capacity)
+            Capacity = Positions.size();
+        glBufferData(GL_ARRAY_BUFFER, Capacity * sizeof(glm::vec3), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, Positions.size() * sizeof(glm::vec3), Positions.data());
+    }
+
+    void Draw()
+    {
+        glPointSize(1.0f);
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_POINTS, 0, Positions.size());
+    }
+
+    ~Point()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+    }
 
+private:
+    void setup(const glm::vec3 *positions, size_t count)
+    {
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
 
@@ -31,26 +106,83 @@ public:
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
 
-        glBufferData(GL_ARRAY_BUFFER, Positions.size() * sizeof(glm::vec3), Positions.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), positions, positions != nullptr ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+        Capacity = count;
 
         glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
     }
+};
+
+// same job as Point, but keeps the cloud quantized on both sides and lets
+// shaders/quant_vert.glsl decode it, one draw call per chunk
+class QuantizedPoint
+{
+public:
+    QuantizedCloud Cloud;
+    // gl variables
+    unsigned int VAO;
+    unsigned int VBO;
+    // points the VBO has room for
+    size_t Capacity = 0;
+
+    QuantizedPoint(size_t capacity, float scale = 0.001f) : Cloud(scale)
+    {
+        Cloud.Offsets.reserve(capacity);
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+        // offset attribute, converted to float by GL and scaled in the shader
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(glm::u16vec3), (void *)0);
+        glEnableVertexAttribArray(0);
+
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::u16vec3), nullptr, GL_DYNAMIC_DRAW);
+        Capacity = capacity;
+
+        glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    }
+
+    // quantize, then upload only the new range
+    void Append(const glm::vec3 *positions, size_t count)
+    {
+        size_t offset = Cloud.size();
+        Cloud.append(positions, count);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (Cloud.size() > Capacity) {
+            Capacity = std::max(Capacity * 2, Cloud.size());
+            glBufferData(GL_ARRAY_BUFFER, Capacity * sizeof(glm::u16vec3), nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, Cloud.size() * sizeof(glm::u16vec3), Cloud.Offsets.data());
+        }
+        else {
+            glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(glm::u16vec3), (Cloud.size() - offset) * sizeof(glm::u16vec3), Cloud.Offsets.data() + offset);
+        }
+    }
 
     void Refresh()
     {
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, Positions.size() * sizeof(glm::vec3), Positions.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, Cloud.size() * sizeof(glm::u16vec3), Cloud.Offsets.data(), GL_STATIC_DRAW);
+        Capacity = Cloud.size();
     }
 
-    void Draw()
+    void Draw(Shader &shader)
     {
         glPointSize(1.0f);
         glBindVertexArray(VAO);
-        glDrawArrays(GL_POINTS, 0, Positions.size());
+        shader.setFloat("scale", Cloud.Scale);
+        for (const auto &chunk : Cloud.Chunks) {
+            shader.setVec3("origin", chunk.Origin);
+            glDrawArrays(GL_POINTS, chunk.First, chunk.Count);
+        }
     }
 
-    ~Point()
+    ~QuantizedPoint()
     {
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO);
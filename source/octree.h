@@ -3,9 +3,18 @@
 
 #include "../glm/glm/glm.hpp"
 #include "../glm/glm/gtc/matrix_transform.hpp"
+#include "arena.h"
+#include "bounds.h"
+#include "morton.h"
+#include "parallel.h"
+#include "voxelsort.h"
 #include <vector>
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <malloc.h>
 
 glm::vec3 OffsetTable[8] = {
     glm::vec3(-1.0f, -1.0f, -1.0f),
@@ -18,29 +27,53 @@ glm::vec3 OffsetTable[8] = {
     glm::vec3(+1.0f, +1.0f, +1.0f),
 };
 
+// leaf cell of a coordinate already inside the root, counted from the root's low face
+// low; leafScale is leaf cells per unit length. this is floor(u), done as a truncation
+// since u is never negative, so a coordinate on a face goes to the upper cell: the
+// floor lattice of VoxelKey and the other voxel sets, and what the float comparisons in
+// Octree::insertLeaf do.
+inline uint32_t octreeGridIndex(float v, double low, double leafScale, unsigned int maxDepth)
+{
+    double u = (static_cast<double>(v) - low) * leafScale;
+    int64_t i = static_cast<int64_t>(u);
+    const int64_t last = (int64_t(1) << maxDepth) - 1;
+    return static_cast<uint32_t>(i < 0 ? 0 : (i > last ? last : i));
+}
+
+// depth whose subtrees Octree::build hands out to the threads; the levels above it are
+// only a few hundred nodes and are linked serially
+const unsigned int OCTREE_SPLIT_DEPTH = 4;
+// deepest tree the 63-bit leaf keys can address; a root that would have to grow past
+// this drops the point instead
+const unsigned int OCTREE_MAX_DEPTH = 21;
+
 class OctreeNode
 {
 public:
-    OctreeNode(glm::vec3 centre, float boxSize, unsigned int code, unsigned int depth)
+    OctreeNode(glm::vec3 centre, float boxSize, unsigned int code, unsigned int height)
     {
         c = centre;
         l = boxSize;
         Code = code;
-        Depth = depth;
+        Height = height;
         for (int i = 0; i < 8; i++)
             Children[i] = nullptr;
     }
-    ~OctreeNode()
-    {
-    }
 
     glm::vec3 c;
     float l;
     unsigned int Code;
-    unsigned int Depth;
+    // levels above the leaves, 0 for a leaf; counted from the bottom so a root that
+    // grows leaves every node below it as it was
+    unsigned int Height;
     OctreeNode* Children[8];
 };
 
+// nodes live in an arena owned by the tree, so a rebuild is clear() plus inserts into
+// memory that is already there, and the whole tree goes away with the Octree.
+// the root starts as a maxSize cube around the origin; fit() shrinks it around the data
+// (build() from points does this itself), and a point from the root inserts outside it
+// make the root grow instead of being dropped.
 class Octree
 {
 public:
@@ -53,35 +86,101 @@ public:
             MaxDepth++;
         }
         std::cout << voxelSize << std::endl;
-        Root = new OctreeNode(
-            glm::vec3(0.0f, 0.0f, 0.0f),
+        RootSize = voxelSize;
+        RootCentre = glm::vec3(0.0f, 0.0f, 0.0f);
+        LeafScale = static_cast<double>(1u << MaxDepth) / RootSize;
+        Root = Nodes.create(
+            RootCentre,
             voxelSize,
             0,
-            0
+            MaxDepth
         );
     }
-    ~Octree()
+
+    Octree(const Octree&) = delete;
+    Octree& operator=(const Octree&) = delete;
+
+    // drop every node but the (fresh) root; the arena keeps its blocks for the next build
+    void clear()
     {
+        Nodes.clear();
+        LeafCount = 0;
+        Version++;
+        Root = Nodes.create(RootCentre, RootSize, 0, MaxDepth);
     }
 
-    void insert(OctreeNode* node, glm::vec3 point)
+    // clear() that also hands the arena's blocks back, for a tree that is no longer needed
+    void release()
     {
-        float _hl = node->l * 0.5f;
-        if (point.x < node->c.x - _hl || point.x > node->c.x + _hl ||
-            point.y < node->c.y - _hl || point.y > node->c.y + _hl ||
-            point.z < node->c.z - _hl || point.z > node->c.z + _hl)
-            return;
+        Nodes.release();
+        // the blocks are below the mmap threshold once glibc has raised it, so they sit
+        // in the heap, which only hands them back to the system when asked to
+        malloc_trim(0);
+        clear();
+    }
 
-        if (node->Depth >= MaxDepth) {
-            return;
+    // empty the tree and make the root the smallest cube of leafSize * 2^n that covers
+    // [min, max], with its low corner on the leaf lattice so leaf centres do not move
+    void fit(const glm::vec3& min, const glm::vec3& max)
+    {
+        const float leafSize = sizeAt(MaxDepth);
+        // the high face belongs to the cell above, so a max on it needs one more leaf
+        glm::vec3 low = glm::floor(min / leafSize) * leafSize;
+        glm::vec3 extent = max - low;
+        float reach = std::max(extent.x, std::max(extent.y, extent.z));
+        MaxDepth = 1;
+        RootSize = leafSize * 2.0f;
+        while (RootSize <= reach && MaxDepth < OCTREE_MAX_DEPTH) {
+            RootSize *= 2.0f;
+            MaxDepth++;
+        }
+        RootCentre = low + glm::vec3(RootSize * 0.5f);
+        LeafScale = static_cast<double>(1u << MaxDepth) / RootSize;
+        clear();
+    }
+
+    // returns true if the point created a new leaf
+    bool insert(OctreeNode* node, glm::vec3 point)
+    {
+        bool created = false;
+        if (node == Root)
+            insertPoint(point, created);
+        else
+            insertLeaf(node, point, created);
+        return created;
+    }
+
+    // merge a batch into the existing tree and append the centres of the leaves it
+    // created, so callers can update just the delta. returns how many were created.
+    size_t insert(const glm::vec3* points, size_t count, std::vector<glm::vec3>& newLeaves)
+    {
+        size_t before = newLeaves.size();
+        for (size_t i = 0; i < count; i++) {
+            bool created = false;
+            OctreeNode* leaf = insertPoint(points[i], created);
+            if (created)
+                newLeaves.push_back(leaf->c);
+        }
+        return newLeaves.size() - before;
+    }
+
+    // descend to the point's leaf, creating nodes on the way; nullptr if the point lies
+    // outside node. created is set when the leaf itself is new.
+    OctreeNode* insertLeaf(OctreeNode* node, const glm::vec3& point, bool& created)
+    {
+        if (!encloses(node->c, node->l, point))
+            return nullptr;
+
+        if (node->Height == 0) {
+            return node;
         }
         // std::cout << "Centre: (" << node->c.x << ", " << node->c.y << ", " << node->c.z << ")" << std::endl;
         unsigned int code = 0;
-        if (point.x > node->c.x)
+        if (point.x >= node->c.x)
             code |= 1;
-        if (point.y > node->c.y)
+        if (point.y >= node->c.y)
             code |= 2;
-        if (point.z > node->c.z)
+        if (point.z >= node->c.z)
             code |= 4;
         if (node->Children[code] == nullptr) {
             float newBoxsize = 0.5f * node->l;
@@ -89,13 +188,145 @@ public:
             glm::vec3 newCentre = node->c + offset;
             // std::cout << "newCentre: (" << newCentre.x << ", " << newCentre.y << ", " << newCentre.z << ")" << std::endl;
 
-            node->Children[code] = new OctreeNode(
-                newCentre, newBoxsize, code, node->Depth + 1
+            node->Children[code] = Nodes.create(
+                newCentre, newBoxsize, code, node->Height - 1
             );
-            if (node->Children[code]->Depth >= MaxDepth)
+            if (node->Children[code]->Height == 0) {
                 LeafCount++;
+                Version++;
+                created = true;
+            }
         }
-        insert(node->Children[code], point);
+        return insertLeaf(node->Children[code], point, created);
+    }
+
+    // insertLeaf from the root without the recursion: the point is turned into leaf grid
+    // coordinates once, and each level's child code is one bit of each coordinate.
+    // only the root runs the float bounds test. octreeGridIndex sends points on a face to
+    // the upper cell like the float comparisons do, so both paths build the same tree.
+    OctreeNode* insertPoint(const glm::vec3& point, bool& created)
+    {
+        if (!isInside(point) && !grow(point))
+            return nullptr;
+
+        const uint32_t ix = gridIndex(point.x, 0);
+        const uint32_t iy = gridIndex(point.y, 1);
+        const uint32_t iz = gridIndex(point.z, 2);
+        OctreeNode* node = Root;
+        for (unsigned int shift = MaxDepth; shift-- > 0;) {
+            unsigned int code = ((ix >> shift) & 1) | (((iy >> shift) & 1) << 1) | (((iz >> shift) & 1) << 2);
+            if (node->Children[code] == nullptr) {
+                float newBoxsize = 0.5f * node->l;
+                glm::vec3 newCentre = node->c + OffsetTable[code] * newBoxsize * 0.5f;
+                node->Children[code] = Nodes.create(newCentre, newBoxsize, code, node->Height - 1);
+                if (shift == 0) {
+                    LeafCount++;
+                    Version++;
+                    created = true;
+                }
+            }
+            node = node->Children[code];
+        }
+        return node;
+    }
+
+    // Morton key of the point's leaf cell, the child codes from the root down, three bits
+    // per level; false if the point lies outside the root
+    bool keyOf(const glm::vec3& point, uint64_t& key) const
+    {
+        if (!isInside(point))
+            return false;
+        key = mortonEncode(gridIndex(point.x, 0), gridIndex(point.y, 1), gridIndex(point.z, 2), 0);
+        return true;
+    }
+
+    // bulk load, replacing whatever the tree held: sorted leaf keys (keyOf, duplicates
+    // allowed) in, the tree repeated insert would build out. each level is made from the
+    // one below in a single pass, since a parent key is its child key shifted right by
+    // one triple. the subtrees under OCTREE_SPLIT_DEPTH are built on all cores, each
+    // thread in its own arena, which the tree takes over afterwards.
+    void build(const std::vector<uint64_t>& sortedKeys, unsigned int threads = 0)
+    {
+        clear();
+        if (MaxDepth == 0 || sortedKeys.empty())
+            return;
+        if (threads == 0)
+            threads = workerCount();
+
+        const unsigned int split = std::min(MaxDepth, OCTREE_SPLIT_DEPTH);
+        const unsigned int shift = 3 * (MaxDepth - split);
+        // keys of subtree g are sortedKeys[groups[g]] .. sortedKeys[groups[g + 1] - 1]
+        std::vector<size_t> groups;
+        for (size_t i = 0; i < sortedKeys.size(); i++) {
+            if (i == 0 || (sortedKeys[i] >> shift) != (sortedKeys[i - 1] >> shift))
+                groups.push_back(i);
+        }
+        groups.push_back(sortedKeys.size());
+        const size_t subtrees = groups.size() - 1;
+
+        std::vector<uint64_t> rootKeys(subtrees);
+        std::vector<OctreeNode*> roots(subtrees);
+        std::vector<NodeArena<OctreeNode>> arenas(threads);
+        std::vector<size_t> leaves(threads, 0);
+        parallelFor(subtrees, threads, [&](unsigned int t, size_t begin, size_t end) {
+            std::vector<uint64_t> keys;
+            std::vector<OctreeNode*> nodes;
+            for (size_t g = begin; g < end; g++) {
+                keys.clear();
+                nodes.clear();
+                for (size_t i = groups[g]; i < groups[g + 1]; i++) {
+                    if (keys.empty() || sortedKeys[i] != keys.back()) {
+                        keys.push_back(sortedKeys[i]);
+                        nodes.push_back(arenas[t].create(glm::vec3(0.0f), sizeAt(MaxDepth),
+                            static_cast<unsigned int>(sortedKeys[i] & 7), 0));
+                    }
+                }
+                leaves[t] += keys.size();
+                for (unsigned int depth = MaxDepth; depth > split; depth--)
+                    linkParents(keys, nodes, depth - 1, arenas[t]);
+                rootKeys[g] = keys[0];
+                roots[g] = nodes[0];
+            }
+        });
+        for (unsigned int t = 0; t < threads; t++) {
+            Nodes.splice(arenas[t]);
+            LeafCount += static_cast<unsigned int>(leaves[t]);
+        }
+
+        for (unsigned int depth = split; depth > 1; depth--)
+            linkParents(rootKeys, roots, depth - 1, Nodes);
+        for (size_t i = 0; i < roots.size(); i++)
+            Root->Children[rootKeys[i] & 7] = roots[i];
+
+        // the centres, top down with the arithmetic insert uses, so they match bit for bit
+        placeChildren(Root, split);
+        parallelFor(roots.size(), threads, [&](unsigned int, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                placeChildren(roots[i], MaxDepth);
+        });
+    }
+
+    // same from points: the root is fitted to their bounds first, then keys on all cores,
+    // radix sort, bulk load
+    void build(const glm::vec3* points, size_t count, unsigned int threads = 0)
+    {
+        glm::vec3 min, max;
+        if (boundsOf(points, count, min, max, threads))
+            fit(min, max);
+        std::vector<uint64_t> keys(count);
+        std::vector<uint8_t> inside(count);
+        parallelFor(count, threads, [&](unsigned int, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                inside[i] = keyOf(points[i], keys[i]);
+        });
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (inside[i])
+                keys[n++] = keys[i];
+        }
+        keys.resize(n);
+        radixSort(keys, threads);
+        build(keys, threads);
     }
 
     void findByY(OctreeNode* node, float z, std::vector<glm::vec3>& points) {
@@ -105,7 +336,7 @@ public:
         if (z < node->c.y - node->l * 1.0f || node->c.y + node->l * 1.0f < z)
             return;
 
-        if (node->Depth >= MaxDepth) {
+        if (node->Height == 0) {
             // std::cout << "Point: (" << node->c.x << ", " << node->c.y << ", " << node->c.z << ")" << std::endl;
             points.push_back(node->c);
         }
@@ -116,10 +347,46 @@ public:
         }
     }
 
+    // centres of the leaves that lie in the box min..max, faces included. subtrees clear
+    // of the box are skipped, and a subtree wholly inside it is copied out without
+    // testing its leaves
+    void findInBox(const glm::vec3& min, const glm::vec3& max, std::vector<glm::vec3>& points) {
+        findInBox(Root, min, max, sizeAt(MaxDepth) * 0.5f, points);
+    }
+
+    void findInBox(OctreeNode* node, const glm::vec3& min, const glm::vec3& max, float inset, std::vector<glm::vec3>& points) {
+        if (node == nullptr)
+            return;
+
+        // the leaf centres of a node lie within half a leaf of its faces
+        float reach = node->l * 0.5f - inset;
+        glm::vec3 lo = node->c - glm::vec3(reach);
+        glm::vec3 hi = node->c + glm::vec3(reach);
+        if (hi.x < min.x || hi.y < min.y || hi.z < min.z ||
+            lo.x > max.x || lo.y > max.y || lo.z > max.z)
+            return;
+
+        if (lo.x >= min.x && lo.y >= min.y && lo.z >= min.z &&
+            hi.x <= max.x && hi.y <= max.y && hi.z <= max.z) {
+            octreeToVector(node, points);
+        }
+        else {
+            for (int i = 0; i < 8; i++) {
+                findInBox(node->Children[i], min, max, inset, points);
+            }
+        }
+    }
+
+    // centres of the leaves with yMin <= y <= yMax; the exact pruning and bulk copy of
+    // findInBox, unlike findByY which keeps every node within a whole node size of y
+    void findInSlab(float yMin, float yMax, std::vector<glm::vec3>& points) {
+        findInBox(glm::vec3(-FLT_MAX, yMin, -FLT_MAX), glm::vec3(FLT_MAX, yMax, FLT_MAX), points);
+    }
+
     void printAll(OctreeNode* node) {
         if (node == nullptr)
             return;
-        if (node->Depth >= MaxDepth) {
+        if (node->Height == 0) {
             std::cout << "Point: (" << node->c.x << ", "
                 << node->c.y << ", "
                 << node->c.z << ")" << std::endl;
@@ -147,7 +414,7 @@ public:
         if (node == nullptr)
             return;
 
-        if (node->Depth >= MaxDepth) {
+        if (node->Height == 0) {
             outputFile << node->c.x << " " << node->c.y << " " << node->c.z << std::endl;
         }
         else {
@@ -161,7 +428,7 @@ public:
         if (node == nullptr)
             return;
 
-        if (node->Depth >= MaxDepth) {
+        if (node->Height == 0) {
             points.push_back(node->c);
         }
         else {
@@ -179,10 +446,162 @@ public:
         return LeafCount;
     }
 
+    unsigned int getMaxDepth() const {
+        return MaxDepth;
+    }
+
+    float getRootSize() const {
+        return RootSize;
+    }
+
+    const glm::vec3& getRootCentre() const {
+        return RootCentre;
+    }
+
+    float getLeafSize() const {
+        return sizeAt(MaxDepth);
+    }
+
+    // changes whenever the set of leaves does (a new leaf, clear, build), so results of
+    // a query can be kept for as long as it stays the same
+    uint64_t getVersion() const {
+        return Version;
+    }
+
+    size_t getNodeCount() const {
+        return Nodes.size();
+    }
+
+    // bytes held by the node arena, including blocks kept from before a clear()
+    size_t memoryBytes() const {
+        return Nodes.memoryBytes();
+    }
+
+    // a cell holds its low faces and not its high ones, the floor rule of the voxel
+    // lattice. a point on the root's high face makes the root grow instead of being
+    // clamped into the last cell; a grown or fitted root then puts it in the same leaf a
+    // larger root would have
+    static bool encloses(const glm::vec3& centre, float size, const glm::vec3& point)
+    {
+        float _hl = size * 0.5f;
+        return !(point.x < centre.x - _hl || point.x >= centre.x + _hl ||
+            point.y < centre.y - _hl || point.y >= centre.y + _hl ||
+            point.z < centre.z - _hl || point.z >= centre.z + _hl);
+    }
+
 private:
+    NodeArena<OctreeNode> Nodes;
     OctreeNode* Root;
+    float RootSize;
+    glm::vec3 RootCentre;
+    // leaf cells per unit length, for insertPoint
+    double LeafScale;
     unsigned int MaxDepth;
     unsigned int LeafCount = 0;
+    uint64_t Version = 0;
+
+    float sizeAt(unsigned int depth) const
+    {
+        float l = RootSize;
+        for (unsigned int d = 0; d < depth; d++)
+            l *= 0.5f;
+        return l;
+    }
+
+    // one level up for Octree::build: keys and nodes (sorted, one level below depth) are
+    // replaced by their parents, which are created in arena and linked to them. centres
+    // are left for placeChildren.
+    void linkParents(std::vector<uint64_t>& keys, std::vector<OctreeNode*>& nodes, unsigned int depth, NodeArena<OctreeNode>& arena)
+    {
+        const float l = sizeAt(depth);
+        size_t n = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            // entry n - 1 is written over entry i or one before it, so read first
+            uint64_t key = keys[i];
+            OctreeNode* child = nodes[i];
+            if (n == 0 || (key >> 3) != keys[n - 1]) {
+                keys[n] = key >> 3;
+                nodes[n] = arena.create(glm::vec3(0.0f), l, static_cast<unsigned int>((key >> 3) & 7), MaxDepth - depth);
+                n++;
+            }
+            nodes[n - 1]->Children[key & 7] = child;
+        }
+        keys.resize(n);
+        nodes.resize(n);
+    }
+
+    // set the centres of everything below node, down to stopDepth
+    void placeChildren(OctreeNode* node, unsigned int stopDepth)
+    {
+        if (MaxDepth - node->Height >= stopDepth)
+            return;
+        for (int code = 0; code < 8; code++) {
+            OctreeNode* child = node->Children[code];
+            if (child != nullptr) {
+                child->c = node->c + OffsetTable[code] * child->l * 0.5f;
+                placeChildren(child, stopDepth);
+            }
+        }
+    }
+
+    uint32_t gridIndex(float v, int axis) const
+    {
+        return octreeGridIndex(v, static_cast<double>(RootCentre[axis]) - RootSize * 0.5, LeafScale, MaxDepth);
+    }
+
+    bool isInside(const glm::vec3& point) const
+    {
+        return encloses(RootCentre, RootSize, point);
+    }
+
+    // double the root towards point until it fits: each time the old root becomes the
+    // child of a new root twice its size, one level higher, and nothing below it
+    // changes. false (nothing changed) for coordinates that are not finite or out of
+    // OCTREE_MAX_DEPTH.
+    bool grow(const glm::vec3& point)
+    {
+        if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+            return false;
+        // count the doublings first, so a point that can never fit changes nothing
+        glm::vec3 centre = RootCentre;
+        float size = RootSize;
+        unsigned int levels = 0;
+        while (!encloses(centre, size, point)) {
+            if (MaxDepth + ++levels > OCTREE_MAX_DEPTH)
+                return false;
+            growCode(point, centre, size);
+            size *= 2.0f;
+        }
+        for (unsigned int n = 0; n < levels; n++) {
+            unsigned int code = growCode(point, RootCentre, RootSize);
+            RootSize *= 2.0f;
+            OctreeNode* root = Nodes.create(RootCentre, RootSize, 0, MaxDepth + 1);
+            Root->Code = code;
+            root->Children[code] = Root;
+            Root = root;
+            MaxDepth++;
+        }
+        LeafScale = static_cast<double>(1u << MaxDepth) / RootSize;
+        return true;
+    }
+
+    // one doubling of a root towards point: moves centre to the bigger root's and
+    // returns the child code the old root takes in it. on every axis the old root goes
+    // to the upper half when the point lies below it.
+    static unsigned int growCode(const glm::vec3& point, glm::vec3& centre, float size)
+    {
+        unsigned int code = 0;
+        const float half = size * 0.5f;
+        for (int axis = 0; axis < 3; axis++) {
+            if (point[axis] < centre[axis]) {
+                code |= 1 << axis;
+                centre[axis] -= half;
+            }
+            else
+                centre[axis] += half;
+        }
+        return code;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,249 @@
+#ifndef OUTLIER_H
+#define OUTLIER_H
+
+#include "../glm/glm/glm.hpp"
+#include "hashgrid.h"
+#include "parallel.h"
+#include "voxelkey.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// points bucketed by a grid whose cells are as wide as the search radius, so every
+// neighbour within that radius sits in one of the 27 cells around the query point.
+// cells are numbered through a VoxelHashGrid and the points are copied out cell by cell
+// (counting sort), so a neighbour query is 27 probes and a few short linear scans.
+class NeighbourGrid
+{
+public:
+    NeighbourGrid(float cellSize) : cells(cellSize) {}
+
+    float getCellSize() const {
+        return cells.getVoxelSize();
+    }
+
+    size_t size() const {
+        return sorted.size();
+    }
+
+    // the k-th point in cell order and its index in the input. queries issued in this
+    // order touch the same few cells over and over instead of the whole grid.
+    const glm::vec3& sortedPoint(size_t k) const {
+        return sorted[k];
+    }
+
+    uint32_t sortedIndex(size_t k) const {
+        return order[k];
+    }
+
+    void build(const glm::vec3* points, size_t count, unsigned int threads = 0) {
+        cells.clear();
+
+        std::vector<uint64_t> keys(count);
+        parallelFor(count, threads, [&](unsigned int, size_t begin, size_t end) {
+            encodeVoxelKeys(points + begin, end - begin, cells.getVoxelSize(), keys.data() + begin);
+        });
+
+        std::vector<uint32_t> cell(count);
+        bool inserted;
+        for (size_t i = 0; i < count; i++)
+            cell[i] = static_cast<uint32_t>(cells.indexOfKey(keys[i], inserted));
+
+        start.assign(cells.size() + 1, 0);
+        for (size_t i = 0; i < count; i++)
+            start[cell[i] + 1]++;
+        for (size_t c = 0; c < cells.size(); c++)
+            start[c + 1] += start[c];
+        order.resize(count);
+        sorted.resize(count);
+        std::vector<uint32_t> cursor(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t k = cursor[cell[i]]++;
+            order[k] = static_cast<uint32_t>(i);
+            sorted[k] = points[i];
+        }
+    }
+
+    // visit(index, squared distance) for every point closer to p than sqrt(limit2), p
+    // itself included, for a visitor that may lower limit2 as it goes (a k-nearest
+    // search). limit2 must start at most at the squared cell size. cells are scanned
+    // nearest first and every cell further away than the current limit is skipped.
+    template <typename F>
+    void forEachWithin(const glm::vec3& p, float& limit2, F visit) const {
+        const float size = cells.getVoxelSize();
+        glm::vec3 g = glm::floor(p / size);
+        // distance from p to the low and high faces of its cell, shaded down a little so
+        // rounding can only make a cell look nearer than it is
+        glm::vec3 below = (p / size - g) * (size * 0.999f);
+        glm::vec3 above = glm::vec3(size * 0.999f) - below;
+        struct Cell
+        {
+            float Distance2;
+            int dx, dy, dz;
+        };
+        Cell order27[27];
+        int n = 0;
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    glm::vec3 d(dx < 0 ? below.x : (dx > 0 ? above.x : 0.0f),
+                        dy < 0 ? below.y : (dy > 0 ? above.y : 0.0f),
+                        dz < 0 ? below.z : (dz > 0 ? above.z : 0.0f));
+                    Cell cell = { glm::dot(d, d), dx, dy, dz };
+                    int at = n++;
+                    while (at > 0 && order27[at - 1].Distance2 > cell.Distance2) {
+                        order27[at] = order27[at - 1];
+                        at--;
+                    }
+                    order27[at] = cell;
+                }
+            }
+        }
+        const int cx = static_cast<int>(g.x), cy = static_cast<int>(g.y), cz = static_cast<int>(g.z);
+        for (int c27 = 0; c27 < 27 && order27[c27].Distance2 < limit2; c27++) {
+            size_t c = cells.findKey(VoxelKey::pack(cx + order27[c27].dx, cy + order27[c27].dy, cz + order27[c27].dz));
+            if (c == SIZE_MAX)
+                continue;
+            for (uint32_t k = start[c]; k < start[c + 1]; k++) {
+                glm::vec3 d = sorted[k] - p;
+                float distance2 = glm::dot(d, d);
+                if (distance2 < limit2)
+                    visit(order[k], distance2);
+            }
+        }
+    }
+
+    // number of points within radius of p (p included), counting stops at limit
+    unsigned int countNear(const glm::vec3& p, float radius, unsigned int limit) const {
+        const float radius2 = radius * radius;
+        unsigned int found = 0;
+        VoxelKey centre = VoxelKey::fromPoint(p, cells.getVoxelSize());
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    size_t c = cells.findKey(VoxelKey::pack(centre.x() + dx, centre.y() + dy, centre.z() + dz));
+                    if (c == SIZE_MAX)
+                        continue;
+                    for (uint32_t k = start[c]; k < start[c + 1]; k++) {
+                        glm::vec3 d = sorted[k] - p;
+                        if (glm::dot(d, d) <= radius2 && ++found >= limit)
+                            return found;
+                    }
+                }
+            }
+        }
+        return found;
+    }
+
+private:
+    VoxelHashGrid cells;
+    // points of cell c are sorted[start[c]] .. sorted[start[c + 1] - 1], and order maps
+    // them back to their index in the input
+    std::vector<uint32_t> start;
+    std::vector<uint32_t> order;
+    std::vector<glm::vec3> sorted;
+};
+
+// drop the points whose keep flag is 0, preserving order; returns how many were removed
+inline size_t compactPoints(std::vector<glm::vec3>& points, const std::vector<uint8_t>& keep)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        if (keep[i])
+            points[n++] = points[i];
+    }
+    size_t removed = points.size() - n;
+    points.resize(n);
+    return removed;
+}
+
+// radius outlier removal: a point stays if at least minNeighbours other points lie
+// within radius of it. one grid build plus a bounded neighbourhood scan per point,
+// spread over all cores; the result does not depend on the thread count.
+inline size_t radiusOutlierFilter(std::vector<glm::vec3>& points, float radius, unsigned int minNeighbours, unsigned int threads = 0)
+{
+    NeighbourGrid grid(radius);
+    grid.build(points.data(), points.size(), threads);
+
+    std::vector<uint8_t> keep(points.size());
+    parallelFor(grid.size(), threads, [&](unsigned int, size_t begin, size_t end) {
+        // the point finds itself too
+        for (size_t k = begin; k < end; k++)
+            keep[grid.sortedIndex(k)] = grid.countNear(grid.sortedPoint(k), radius, minNeighbours + 1) > minNeighbours;
+    });
+    return compactPoints(points, keep);
+}
+
+const unsigned int STATISTICAL_MAX_K = 64;
+
+// statistical outlier removal: mean distance of every point to its k nearest neighbours,
+// then points further than mean + stddevMul * stddev of those means are dropped.
+// neighbours are only searched within radius; a point with fewer than k there is too
+// sparse to have a mean and is dropped outright, and kept out of the statistics so it
+// can not widen the spread the dense points are judged by. k is capped at
+// STATISTICAL_MAX_K.
+inline size_t statisticalOutlierFilter(std::vector<glm::vec3>& points, unsigned int k, float stddevMul, float radius, unsigned int threads = 0)
+{
+    NeighbourGrid grid(radius);
+    grid.build(points.data(), points.size(), threads);
+    k = std::min(std::max(1u, k), STATISTICAL_MAX_K);
+
+    std::vector<float> meanDistance(points.size());
+    parallelFor(grid.size(), threads, [&](unsigned int, size_t begin, size_t end) {
+        // the k smallest squared distances seen so far, ascending. k is small, so an
+        // insertion into a flat array beats a heap by a wide margin
+        float nearest[STATISTICAL_MAX_K];
+        for (size_t q = begin; q < end; q++) {
+            const uint32_t i = grid.sortedIndex(q);
+            unsigned int found = 0;
+            // once k are found only nearer ones matter, which lets whole cells be skipped;
+            // the k smallest distances are the same whatever order they are met in
+            float limit2 = std::nextafter(radius * radius, FLT_MAX);
+            grid.forEachWithin(grid.sortedPoint(q), limit2, [&](uint32_t j, float distance2) {
+                if (j == i)
+                    return;
+                unsigned int n = (found < k) ? found++ : k - 1;
+                while (n > 0 && nearest[n - 1] > distance2) {
+                    nearest[n] = nearest[n - 1];
+                    n--;
+                }
+                nearest[n] = distance2;
+                if (found == k)
+                    limit2 = nearest[k - 1];
+            });
+            if (found < k) {
+                meanDistance[i] = -1.0f;
+                continue;
+            }
+            float sum = 0.0f;
+            for (unsigned int n = 0; n < k; n++)
+                sum += std::sqrt(nearest[n]);
+            meanDistance[i] = sum / static_cast<float>(k);
+        }
+    });
+
+    // a negative mean marks a point with too few neighbours
+    double sum = 0.0, sum2 = 0.0;
+    size_t dense = 0;
+    for (float d : meanDistance) {
+        if (d < 0.0f)
+            continue;
+        sum += d;
+        sum2 += static_cast<double>(d) * d;
+        dense++;
+    }
+    double n = std::max<double>(1.0, static_cast<double>(dense));
+    double mean = sum / n;
+    double stddev = std::sqrt(std::max(0.0, sum2 / n - mean * mean));
+    const float threshold = static_cast<float>(mean + stddevMul * stddev);
+
+    std::vector<uint8_t> keep(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+        keep[i] = meanDistance[i] >= 0.0f && meanDistance[i] <= threshold;
+    return compactPoints(points, keep);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// number of worker threads for the parallel passes
+inline unsigned int workerCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// split [0, count) into one contiguous slice per thread and run fn(thread, begin, end)
+// on each. slices depend only on count and threads, so callers can rely on slice t
+// always covering the same range. the calling thread runs the last slice itself.
+template <typename F>
+void parallelFor(size_t count, unsigned int threads, F fn)
+{
+    if (threads == 0)
+        threads = workerCount();
+    threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t + 1 < threads; t++)
+        workers.emplace_back(fn, t, count * t / threads, count * (t + 1) / threads);
+    fn(threads - 1, count * (threads - 1) / threads, count);
+    for (auto& w : workers)
+        w.join();
+}
+
+#endif
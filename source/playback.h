@@ -0,0 +1,152 @@
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include "../glm/glm/glm.hpp"
+#include "reader.h"
+
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+inline bool isDirectory(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+inline bool isFramePattern(const std::string& path)
+{
+    return isDirectory(path) || path.find_first_of("*?[") != std::string::npos;
+}
+
+// frames of a recorded sequence: every regular file in a directory, or every match
+// of a glob, in name order
+inline std::vector<std::string> listFrames(const std::string& path)
+{
+    std::vector<std::string> frames;
+
+    if (isDirectory(path)) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr)
+            return frames;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.empty() || name[0] == '.')
+                continue;
+            std::string full = path + "/" + name;
+            if (!isDirectory(full))
+                frames.push_back(full);
+        }
+        closedir(dir);
+    }
+    else {
+        glob_t result;
+        if (glob(path.c_str(), 0, nullptr, &result) == 0) {
+            for (size_t i = 0; i < result.gl_pathc; i++)
+                frames.push_back(result.gl_pathv[i]);
+        }
+        globfree(&result);
+    }
+
+    std::sort(frames.begin(), frames.end());
+    return frames;
+}
+
+// plays a frame sequence, decoding frame N+1 on a worker thread while frame N is shown.
+// frames live in two vectors that trade places, so taking a frame never copies points.
+class FramePlayer
+{
+public:
+    FramePlayer(const std::vector<std::string>& frames, bool loop = true) : Frames(frames), loop(loop)
+    {
+        if (!Frames.empty())
+            worker = std::thread(&FramePlayer::run, this);
+    }
+    ~FramePlayer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    std::vector<std::string> Frames;
+    // index of the frame last handed out by next()
+    size_t Current = 0;
+
+    // if the next frame is decoded, swap it into front and return true. the old
+    // contents of front become the worker's buffer for the frame after that.
+    bool next(std::vector<glm::vec3>& front) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ready)
+                return false;
+            front.swap(back);
+            Current = backIndex;
+            ready = false;
+        }
+        changed.notify_one();
+        return true;
+    }
+
+    // wait for the next frame instead of polling
+    bool waitNext(std::vector<glm::vec3>& front) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return ready || finished; });
+        }
+        return next(front);
+    }
+
+private:
+    bool loop;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<glm::vec3> back;
+    size_t backIndex = 0;
+    bool ready = false;
+    bool finished = false;
+    bool stopping = false;
+
+    void run() {
+        size_t index = 0;
+        std::vector<glm::vec3> decoded;
+        while (true) {
+            decoded.clear();
+            readPointFile(Frames[index], decoded);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return stopping || !ready; });
+            if (stopping)
+                return;
+            // hand the decoded frame over and keep the returned buffer's capacity
+            back.swap(decoded);
+            backIndex = index;
+            ready = true;
+            changed.notify_all();
+
+            index++;
+            if (index == Frames.size()) {
+                if (!loop) {
+                    finished = true;
+                    changed.notify_all();
+                    return;
+                }
+                index = 0;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include "../glm/glm/glm.hpp"
+#include "reader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// reads a cloud on a worker thread and hands it to the render loop in chunks.
+// the queue is bounded, so a slow consumer throttles the reader instead of letting
+// the whole file pile up in memory.
+class ProgressiveLoader
+{
+public:
+    ProgressiveLoader(size_t maxQueued = 64) : maxQueued(maxQueued) {}
+    ~ProgressiveLoader()
+    {
+        stop();
+    }
+
+    // returns false if the file can not be read; capacityHint is filled before the worker starts
+    bool start(const std::string& filename) {
+        stop();
+        reader = openPointReader(filename);
+        if (!reader->isOpen()) {
+            delete reader;
+            reader = nullptr;
+            return false;
+        }
+        finished = false;
+        cancelled = false;
+        Loaded = 0;
+        worker = std::thread(&ProgressiveLoader::run, this);
+        return true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+        }
+        space.notify_all();
+        if (worker.joinable())
+            worker.join();
+        delete reader;
+        reader = nullptr;
+        chunks.clear();
+    }
+
+    uint64_t capacityHint() const {
+        return reader != nullptr ? reader->capacityHint() : 0;
+    }
+
+    // move up to maxChunks ready chunks to the end of out, never blocks
+    size_t poll(std::vector<glm::vec3>& out, size_t maxChunks = SIZE_MAX) {
+        size_t n = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!chunks.empty() && n < maxChunks) {
+            std::vector<glm::vec3> chunk;
+            chunk.swap(chunks.front());
+            chunks.pop_front();
+            lock.unlock();
+            out.insert(out.end(), chunk.begin(), chunk.end());
+            n++;
+            lock.lock();
+        }
+        lock.unlock();
+        if (n > 0)
+            space.notify_one();
+        return n;
+    }
+
+    // the worker is done and everything has been polled
+    bool isDone() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return finished && chunks.empty();
+    }
+
+    // points read by the worker so far
+    std::atomic<uint64_t> Loaded{ 0 };
+
+private:
+    size_t maxQueued;
+    PointReader* reader = nullptr;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable space;
+    std::deque<std::vector<glm::vec3>> chunks;
+    bool finished = false;
+    bool cancelled = false;
+
+    void run() {
+        std::vector<glm::vec3> block;
+        while (reader->read(block) > 0) {
+            Loaded += block.size();
+            std::unique_lock<std::mutex> lock(mutex);
+            space.wait(lock, [this]() { return cancelled || chunks.size() < maxQueued; });
+            if (cancelled)
+                break;
+            chunks.push_back(std::vector<glm::vec3>());
+            chunks.back().swap(block);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include "../glm/glm/glm.hpp"
+#include "voxelsort.h"
+
+#include <vector>
+
+// voxel sets at the base size and every doubling above it (0.25, 0.5, 1, 2 m by default).
+// only the finest level ever looks at points; each coarser level is derived from the one
+// below by shifting its Morton keys, see MortonVoxelSet::coarsen.
+class VoxelPyramid
+{
+public:
+    std::vector<MortonVoxelSet> Levels;
+
+    VoxelPyramid(float voxelSize = 1.0f, unsigned int levels = 4)
+    {
+        for (unsigned int i = 0; i < levels; i++)
+            Levels.push_back(MortonVoxelSet(voxelSize * static_cast<float>(1 << i)));
+    }
+
+    size_t levelCount() const {
+        return Levels.size();
+    }
+
+    const MortonVoxelSet& level(size_t i) const {
+        return Levels[i];
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const auto& level : Levels)
+            bytes += level.memoryBytes();
+        return bytes;
+    }
+
+    void build(const glm::vec3* points, size_t count, unsigned int threads = 0) {
+        Levels[0].build(points, count, threads);
+        coarsen(threads);
+    }
+
+    void build(const std::vector<glm::vec3>& points, unsigned int threads = 0) {
+        build(points.data(), points.size(), threads);
+    }
+
+    // unsorted finest-level keys (MortonVoxelSet::keyOf of level 0) in, whole pyramid out
+    void buildFromKeys(std::vector<uint64_t>& keys, unsigned int threads = 0) {
+        Levels[0].buildFromKeys(keys, threads);
+        coarsen(threads);
+    }
+
+    void findByY(size_t i, float y, std::vector<glm::vec3>& points) const {
+        Levels[i].findByY(y, points);
+    }
+
+private:
+    void coarsen(unsigned int threads) {
+        for (size_t i = 1; i < Levels.size(); i++)
+            Levels[i].coarsen(Levels[i - 1], threads);
+    }
+};
+
+#endif
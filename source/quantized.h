@@ -0,0 +1,200 @@
+#ifndef QUANTIZED_H
+#define QUANTIZED_H
+
+#include "../glm/glm/glm.hpp"
+#include "../glm/glm/gtc/type_precision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// LAS-style fixed point cloud: every point is three uint16 steps of Scale metres above
+// the origin of the chunk it belongs to. 6 bytes per point instead of 12.
+// chunks are cells of a 65535 * Scale grid, so any cloud extent fits in 16 bits;
+// the vertex shader rebuilds positions as Origin + offset * Scale.
+
+// points decoded at a time by QuantizedCloud::forEachBlock; 12 MB of floats
+const size_t QUANTIZED_DECODE_BLOCK = 1 << 20;
+
+struct QuantizedChunk
+{
+    glm::vec3 Origin;
+    size_t First;
+    size_t Count;
+};
+
+class QuantizedCloud
+{
+public:
+    // metres per step; 1 mm keeps us below the sensor noise and gives 65 m per chunk
+    float Scale;
+
+    std::vector<glm::u16vec3> Offsets;
+    std::vector<QuantizedChunk> Chunks;
+
+    QuantizedCloud(float scale = 0.001f)
+    {
+        Scale = scale;
+    }
+
+    size_t size() const {
+        return Offsets.size();
+    }
+
+    void clear() {
+        Offsets.clear();
+        Chunks.clear();
+    }
+
+    // bytes held on the CPU, chunk table included
+    size_t memoryBytes() const {
+        return Offsets.capacity() * sizeof(glm::u16vec3) + Chunks.capacity() * sizeof(QuantizedChunk);
+    }
+
+    // quantize and append. each block is bucketed by a grid of 65535 * Scale cells and
+    // every occupied cell becomes a chunk with the cell corner as origin, so points stay
+    // grouped by cell (in their original order inside it). the block's points in the cell
+    // of the last chunk go first and extend that chunk, so a scan that stays in one cell
+    // keeps one chunk; regroup() merges the rest once the cloud is complete.
+    void append(const glm::vec3* points, size_t count) {
+        const float range = 65535.0f * Scale;
+        const float inv = 1.0f / range;
+
+        std::vector<uint32_t> slot(count);
+        std::vector<glm::ivec3> cells;
+        std::vector<size_t> sizes;
+        std::unordered_map<uint64_t, uint32_t> index;
+        for (size_t i = 0; i < count; i++) {
+            glm::ivec3 c = glm::ivec3(glm::floor(points[i] * inv));
+            uint64_t key = (static_cast<uint64_t>(c.x + (1 << 20)) << 42) |
+                (static_cast<uint64_t>(c.y + (1 << 20)) << 21) |
+                static_cast<uint64_t>(c.z + (1 << 20));
+            auto it = index.find(key);
+            if (it == index.end()) {
+                it = index.insert(std::make_pair(key, static_cast<uint32_t>(cells.size()))).first;
+                cells.push_back(c);
+                sizes.push_back(0);
+            }
+            slot[i] = it->second;
+            sizes[it->second]++;
+        }
+
+        // the cell of the last chunk, if the block has points there, is laid out first
+        size_t lead = cells.size();
+        if (!Chunks.empty()) {
+            for (size_t c = 0; c < cells.size(); c++) {
+                if (glm::vec3(cells[c]) * range == Chunks.back().Origin)
+                    lead = c;
+            }
+        }
+        std::vector<size_t> cursor(cells.size());
+        size_t first = Offsets.size();
+        if (lead < cells.size()) {
+            Chunks.back().Count += sizes[lead];
+            cursor[lead] = first;
+            first += sizes[lead];
+        }
+        for (size_t c = 0; c < cells.size(); c++) {
+            if (c == lead)
+                continue;
+            QuantizedChunk chunk;
+            chunk.Origin = glm::vec3(cells[c]) * range;
+            chunk.First = first;
+            chunk.Count = sizes[c];
+            Chunks.push_back(chunk);
+            cursor[c] = first;
+            first += sizes[c];
+        }
+
+        const float step = 1.0f / Scale;
+        Offsets.resize(first);
+        for (size_t i = 0; i < count; i++) {
+            const glm::vec3 origin = glm::vec3(cells[slot[i]]) * range;
+            glm::vec3 q = glm::floor((points[i] - origin) * step + 0.5f);
+            q = glm::clamp(q, glm::vec3(0.0f), glm::vec3(65535.0f));
+            Offsets[cursor[slot[i]]++] = glm::u16vec3(q);
+        }
+    }
+
+    // one chunk per occupied cell: the chunks of each cell are moved next to each other,
+    // cells in the order they were first seen and points in their order inside a cell.
+    // offsets stay valid, only their position in Offsets changes.
+    void regroup() {
+        std::vector<QuantizedChunk> merged;
+        // chunk k goes into merged[cell[k]]
+        std::vector<uint32_t> cell(Chunks.size());
+        // a cell is 65 m wide, so there are few of them and a linear search finds them
+        for (size_t k = 0; k < Chunks.size(); k++) {
+            size_t m = 0;
+            while (m < merged.size() && merged[m].Origin != Chunks[k].Origin)
+                m++;
+            if (m == merged.size()) {
+                QuantizedChunk chunk = { Chunks[k].Origin, 0, 0 };
+                merged.push_back(chunk);
+            }
+            merged[m].Count += Chunks[k].Count;
+            cell[k] = static_cast<uint32_t>(m);
+        }
+        if (merged.size() == Chunks.size())
+            return;
+
+        size_t first = 0;
+        for (auto& chunk : merged) {
+            chunk.First = first;
+            first += chunk.Count;
+        }
+        std::vector<size_t> cursor(merged.size());
+        for (size_t m = 0; m < merged.size(); m++)
+            cursor[m] = merged[m].First;
+        std::vector<glm::u16vec3> offsets(Offsets.size());
+        for (size_t k = 0; k < Chunks.size(); k++) {
+            std::copy(Offsets.begin() + Chunks[k].First, Offsets.begin() + Chunks[k].First + Chunks[k].Count,
+                offsets.begin() + cursor[cell[k]]);
+            cursor[cell[k]] += Chunks[k].Count;
+        }
+        Offsets.swap(offsets);
+        Chunks.swap(merged);
+    }
+
+    void assign(const std::vector<glm::vec3>& points) {
+        clear();
+        append(points.data(), points.size());
+    }
+
+    // visit every decoded point in order without materialising the float cloud
+    template <typename F>
+    void forEach(F visit) const {
+        for (const auto& chunk : Chunks) {
+            const glm::u16vec3* q = Offsets.data() + chunk.First;
+            for (size_t i = 0; i < chunk.Count; i++)
+                visit(chunk.Origin + glm::vec3(q[i]) * Scale);
+        }
+    }
+
+    // visit(points, count) for consecutive runs of at most blockPoints decoded points, in
+    // order; only one run is held as floats at a time
+    template <typename F>
+    void forEachBlock(F visit, size_t blockPoints = QUANTIZED_DECODE_BLOCK) const {
+        std::vector<glm::vec3> block;
+        block.reserve(std::min(blockPoints, Offsets.size()));
+        forEach([&](const glm::vec3& p) {
+            block.push_back(p);
+            if (block.size() == blockPoints) {
+                visit(block.data(), block.size());
+                block.clear();
+            }
+        });
+        if (!block.empty())
+            visit(block.data(), block.size());
+    }
+
+    void decode(std::vector<glm::vec3>& out) const {
+        out.clear();
+        out.reserve(Offsets.size());
+        forEach([&out](const glm::vec3& p) { out.push_back(p); });
+    }
+};
+
+#endif
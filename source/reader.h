@@ -0,0 +1,652 @@
+#ifndef READER_H
+#define READER_H
+
+#include "../glm/glm/glm.hpp"
+#include "loader.h"
+#include "cloudfile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// streaming readers for robot exports (binary PCD and PLY) and our own formats.
+// they hand out fixed-size blocks of points, so memory stays bounded no matter how
+// large the capture is. all formats here are little-endian, like the host.
+
+const size_t READ_BLOCK_POINTS = 1 << 16;
+// text parsed per step by TextReader once it is up to speed, enough for every core to
+// get a few MB; the first window is one block's worth so the first points come quickly
+const size_t TEXT_WINDOW_BYTES = 32 << 20;
+
+class PointReader
+{
+public:
+    // number of points announced by the header
+    uint64_t Count = 0;
+
+    virtual ~PointReader() {}
+
+    virtual bool isOpen() const = 0;
+
+    // how many points to make room for; the header count unless the format has none
+    virtual uint64_t capacityHint() const {
+        return Count;
+    }
+
+    // clears block and fills it with up to maxPoints points; returns 0 at the end
+    virtual size_t read(std::vector<glm::vec3>& block, size_t maxPoints = READ_BLOCK_POINTS) = 0;
+};
+
+// scalar field of a binary record, only float32 and float64 can hold coordinates
+struct FieldSlot
+{
+    size_t Offset = 0;
+    size_t Size = 0;
+    bool Found = false;
+};
+
+inline float readScalar(const char* p, size_t size)
+{
+    if (size == 8) {
+        double d;
+        memcpy(&d, p, 8);
+        return static_cast<float>(d);
+    }
+    float f;
+    memcpy(&f, p, 4);
+    return f;
+}
+
+// LZF decoder that produces its output incrementally. LZF back references reach at
+// most 8 KB back, so a small ring of recent output is all the state it needs.
+class LZFStream
+{
+public:
+    LZFStream(const uint8_t* data = nullptr, size_t size = 0) : in(data), end(data + size) {}
+
+    // decode up to n bytes into dst (or discard them when dst is null), returns bytes produced
+    size_t read(uint8_t* dst, size_t n) {
+        size_t done = 0;
+        while (done < n) {
+            if (literal > 0) {
+                if (in >= end)
+                    break;
+                put(*in++, dst, done);
+                literal--;
+            }
+            else if (copy > 0) {
+                put(window[(pos - distance) & WINDOW_MASK], dst, done);
+                copy--;
+            }
+            else {
+                if (in >= end)
+                    break;
+                unsigned int ctrl = *in++;
+                if (ctrl < 32) {
+                    literal = ctrl + 1;
+                    continue;
+                }
+                size_t len = ctrl >> 5;
+                if (len == 7) {
+                    if (in >= end)
+                        break;
+                    len += *in++;
+                }
+                if (in >= end)
+                    break;
+                distance = ((ctrl & 0x1f) << 8) + *in++ + 1;
+                if (distance > pos) {
+                    // reference before the start of the stream, data is corrupt
+                    in = end;
+                    break;
+                }
+                copy = len + 2;
+            }
+        }
+        return done;
+    }
+
+    size_t skip(size_t n) {
+        return read(nullptr, n);
+    }
+
+private:
+    static const size_t WINDOW_SIZE = 1 << 14;
+    static const size_t WINDOW_MASK = WINDOW_SIZE - 1;
+
+    const uint8_t* in;
+    const uint8_t* end;
+    uint8_t window[WINDOW_SIZE];
+    size_t pos = 0;
+    size_t literal = 0;
+    size_t copy = 0;
+    size_t distance = 0;
+
+    void put(uint8_t b, uint8_t* dst, size_t& done) {
+        window[pos & WINDOW_MASK] = b;
+        pos++;
+        if (dst != nullptr)
+            dst[done] = b;
+        done++;
+    }
+};
+
+// PCD v0.7, DATA binary or binary_compressed
+class PCDReader : public PointReader
+{
+public:
+    PCDReader(const std::string& filename) : name(filename)
+    {
+        fp = fopen(filename.c_str(), "rb");
+        if (fp == nullptr) {
+            std::cout << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        if (!parseHeader())
+            return;
+
+        if (compressed)
+            openCompressed();
+        else
+            ok = true;
+    }
+    ~PCDReader()
+    {
+        if (fp != nullptr)
+            fclose(fp);
+        delete mapping;
+        for (int i = 0; i < 3; i++)
+            delete decoders[i];
+    }
+
+    bool isOpen() const override {
+        return ok;
+    }
+
+    size_t read(std::vector<glm::vec3>& block, size_t maxPoints = READ_BLOCK_POINTS) override {
+        block.clear();
+        if (!ok || done >= Count)
+            return 0;
+
+        size_t n = static_cast<size_t>(std::min<uint64_t>(maxPoints, Count - done));
+        size_t got = compressed ? readCompressed(block, n) : readBinary(block, n);
+        done += got;
+        if (got < n) {
+            std::cout << "Truncated PCD file: " << name << std::endl;
+            done = Count;
+        }
+        return got;
+    }
+
+private:
+    std::string name;
+    FILE* fp = nullptr;
+    bool ok = false;
+    bool compressed = false;
+    FieldSlot xyz[3];
+    // byte offset of each field's column in the decompressed, field-major payload
+    uint64_t columnOffset[3] = { 0, 0, 0 };
+    size_t stride = 0;
+    long dataOffset = 0;
+    uint64_t done = 0;
+
+    std::vector<char> buffer;
+    MappedFile* mapping = nullptr;
+    LZFStream* decoders[3] = { nullptr, nullptr, nullptr };
+
+    bool parseHeader() {
+        std::vector<std::string> fields;
+        std::vector<size_t> sizes, counts;
+        std::vector<char> types;
+        uint64_t width = 0, height = 1;
+        bool hasPoints = false;
+        std::string data;
+
+        char line[4096];
+        while (fgets(line, sizeof(line), fp) != nullptr) {
+            std::istringstream iss(line);
+            std::string key;
+            if (!(iss >> key) || key[0] == '#')
+                continue;
+
+            if (key == "FIELDS") {
+                std::string f;
+                while (iss >> f)
+                    fields.push_back(f);
+            }
+            else if (key == "SIZE") {
+                size_t v;
+                while (iss >> v)
+                    sizes.push_back(v);
+            }
+            else if (key == "TYPE") {
+                char t;
+                while (iss >> t)
+                    types.push_back(t);
+            }
+            else if (key == "COUNT") {
+                size_t v;
+                while (iss >> v)
+                    counts.push_back(v);
+            }
+            else if (key == "WIDTH")
+                iss >> width;
+            else if (key == "HEIGHT")
+                iss >> height;
+            else if (key == "POINTS") {
+                iss >> Count;
+                hasPoints = true;
+            }
+            else if (key == "DATA") {
+                iss >> data;
+                break;
+            }
+        }
+        dataOffset = ftell(fp);
+        if (!hasPoints)
+            Count = width * height;
+        if (counts.empty())
+            counts.assign(fields.size(), 1);
+
+        if (data != "binary" && data != "binary_compressed") {
+            std::cout << "Unsupported PCD data type '" << data << "': " << name << std::endl;
+            return false;
+        }
+        compressed = (data == "binary_compressed");
+
+        if (fields.empty() || sizes.size() != fields.size() || types.size() != fields.size() || counts.size() != fields.size()) {
+            std::cout << "Malformed PCD header: " << name << std::endl;
+            return false;
+        }
+
+        const char* axes[3] = { "x", "y", "z" };
+        uint64_t column = 0;
+        for (size_t i = 0; i < fields.size(); i++) {
+            for (int a = 0; a < 3; a++) {
+                if (fields[i] != axes[a])
+                    continue;
+                if (types[i] != 'F' || (sizes[i] != 4 && sizes[i] != 8)) {
+                    std::cout << "PCD field " << axes[a] << " is not a float: " << name << std::endl;
+                    return false;
+                }
+                xyz[a].Offset = stride;
+                xyz[a].Size = sizes[i];
+                xyz[a].Found = true;
+                columnOffset[a] = column;
+            }
+            stride += sizes[i] * counts[i];
+            column += sizes[i] * counts[i] * Count;
+        }
+        for (int a = 0; a < 3; a++) {
+            if (!xyz[a].Found) {
+                std::cout << "PCD file has no " << axes[a] << " field: " << name << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t readBinary(std::vector<glm::vec3>& block, size_t n) {
+        buffer.resize(n * stride);
+        n = fread(buffer.data(), stride, n, fp);
+
+        block.resize(n);
+        const char* p = buffer.data();
+        for (size_t i = 0; i < n; i++, p += stride) {
+            block[i] = glm::vec3(
+                readScalar(p + xyz[0].Offset, xyz[0].Size),
+                readScalar(p + xyz[1].Offset, xyz[1].Size),
+                readScalar(p + xyz[2].Offset, xyz[2].Size));
+        }
+        return n;
+    }
+
+    // binary_compressed stores the whole cloud as one LZF stream of field-major columns.
+    // instead of inflating all of it we run one decoder per axis over the mapped file,
+    // each parked at the start of its column, and pull a block from each in lockstep.
+    void openCompressed() {
+        uint32_t sizes[2];
+        if (fread(sizes, sizeof(uint32_t), 2, fp) != 2) {
+            std::cout << "Truncated PCD file: " << name << std::endl;
+            return;
+        }
+        if (static_cast<uint64_t>(sizes[1]) != stride * Count) {
+            std::cout << "PCD compressed size does not match header: " << name << std::endl;
+            return;
+        }
+
+        mapping = new MappedFile(name);
+        size_t payload = static_cast<size_t>(dataOffset) + 2 * sizeof(uint32_t);
+        if (!mapping->isOpen() || mapping->Size < payload + sizes[0]) {
+            std::cout << "Truncated PCD file: " << name << std::endl;
+            return;
+        }
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(mapping->Data) + payload;
+        for (int a = 0; a < 3; a++) {
+            decoders[a] = new LZFStream(data, sizes[0]);
+            if (decoders[a]->skip(static_cast<size_t>(columnOffset[a])) != columnOffset[a]) {
+                std::cout << "Corrupt PCD compressed data: " << name << std::endl;
+                return;
+            }
+        }
+        ok = true;
+    }
+
+    size_t readCompressed(std::vector<glm::vec3>& block, size_t n) {
+        buffer.resize(n * 8 * 3);
+        char* column[3];
+        for (int a = 0; a < 3; a++) {
+            column[a] = buffer.data() + n * 8 * a;
+            size_t bytes = n * xyz[a].Size;
+            size_t got = decoders[a]->read(reinterpret_cast<uint8_t*>(column[a]), bytes);
+            n = std::min(n, got / xyz[a].Size);
+        }
+
+        block.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            block[i] = glm::vec3(
+                readScalar(column[0] + i * xyz[0].Size, xyz[0].Size),
+                readScalar(column[1] + i * xyz[1].Size, xyz[1].Size),
+                readScalar(column[2] + i * xyz[2].Size, xyz[2].Size));
+        }
+        return n;
+    }
+};
+
+// PLY, format binary_little_endian, vertex element with float/double x y z
+class PLYReader : public PointReader
+{
+public:
+    PLYReader(const std::string& filename) : name(filename)
+    {
+        fp = fopen(filename.c_str(), "rb");
+        if (fp == nullptr) {
+            std::cout << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        ok = parseHeader();
+    }
+    ~PLYReader()
+    {
+        if (fp != nullptr)
+            fclose(fp);
+    }
+
+    bool isOpen() const override {
+        return ok;
+    }
+
+    size_t read(std::vector<glm::vec3>& block, size_t maxPoints = READ_BLOCK_POINTS) override {
+        block.clear();
+        if (!ok || done >= Count)
+            return 0;
+
+        size_t n = static_cast<size_t>(std::min<uint64_t>(maxPoints, Count - done));
+        buffer.resize(n * stride);
+        size_t got = fread(buffer.data(), stride, n, fp);
+
+        block.resize(got);
+        const char* p = buffer.data();
+        for (size_t i = 0; i < got; i++, p += stride) {
+            block[i] = glm::vec3(
+                readScalar(p + xyz[0].Offset, xyz[0].Size),
+                readScalar(p + xyz[1].Offset, xyz[1].Size),
+                readScalar(p + xyz[2].Offset, xyz[2].Size));
+        }
+
+        done += got;
+        if (got < n) {
+            std::cout << "Truncated PLY file: " << name << std::endl;
+            done = Count;
+        }
+        return got;
+    }
+
+private:
+    std::string name;
+    FILE* fp = nullptr;
+    bool ok = false;
+    FieldSlot xyz[3];
+    size_t stride = 0;
+    uint64_t done = 0;
+    std::vector<char> buffer;
+
+    static size_t typeSize(const std::string& type) {
+        if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+            return 1;
+        if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+            return 2;
+        if (type == "int" || type == "uint" || type == "int32" || type == "uint32" ||
+            type == "float" || type == "float32")
+            return 4;
+        if (type == "double" || type == "float64")
+            return 8;
+        return 0;
+    }
+
+    bool parseHeader() {
+        char line[4096];
+        if (fgets(line, sizeof(line), fp) == nullptr || strncmp(line, "ply", 3) != 0) {
+            std::cout << "Not a PLY file: " << name << std::endl;
+            return false;
+        }
+
+        // elements that come before "vertex" are skipped, so they must be fixed size
+        uint64_t skipBytes = 0;
+        std::string element;
+        uint64_t elementCount = 0;
+        size_t elementStride = 0;
+        bool variable = false;
+        bool inVertex = false;
+        bool seenVertex = false;
+
+        while (fgets(line, sizeof(line), fp) != nullptr) {
+            std::istringstream iss(line);
+            std::string key;
+            if (!(iss >> key))
+                continue;
+
+            if (key == "format") {
+                std::string format;
+                iss >> format;
+                if (format != "binary_little_endian") {
+                    std::cout << "Unsupported PLY format '" << format << "': " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (key == "element") {
+                if (!seenVertex && !element.empty()) {
+                    if (variable) {
+                        std::cout << "PLY element '" << element << "' before vertex has lists: " << name << std::endl;
+                        return false;
+                    }
+                    skipBytes += elementCount * elementStride;
+                }
+                iss >> element >> elementCount;
+                elementStride = 0;
+                variable = false;
+                inVertex = (element == "vertex" && !seenVertex);
+                if (inVertex) {
+                    seenVertex = true;
+                    Count = elementCount;
+                }
+            }
+            else if (key == "property") {
+                std::string type, prop;
+                iss >> type;
+                if (type == "list") {
+                    variable = true;
+                    if (inVertex) {
+                        std::cout << "PLY vertex element with list properties is not supported: " << name << std::endl;
+                        return false;
+                    }
+                    continue;
+                }
+                iss >> prop;
+                size_t size = typeSize(type);
+                if (size == 0) {
+                    std::cout << "Unknown PLY type '" << type << "': " << name << std::endl;
+                    return false;
+                }
+                if (inVertex) {
+                    int a = (prop == "x") ? 0 : (prop == "y") ? 1 : (prop == "z") ? 2 : -1;
+                    if (a >= 0) {
+                        if (type != "float" && type != "float32" && type != "double" && type != "float64") {
+                            std::cout << "PLY property " << prop << " is not a float: " << name << std::endl;
+                            return false;
+                        }
+                        xyz[a].Offset = elementStride;
+                        xyz[a].Size = size;
+                        xyz[a].Found = true;
+                    }
+                    stride += size;
+                }
+                elementStride += size;
+            }
+            else if (key == "end_header") {
+                break;
+            }
+        }
+
+        if (!seenVertex || !xyz[0].Found || !xyz[1].Found || !xyz[2].Found) {
+            std::cout << "PLY file has no vertex x/y/z: " << name << std::endl;
+            return false;
+        }
+        if (skipBytes > 0)
+            fseek(fp, static_cast<long>(skipBytes), SEEK_CUR);
+        return true;
+    }
+};
+
+// "x y z" text dump, parsed block by block out of the mapping
+class TextReader : public PointReader
+{
+public:
+    TextReader(const std::string& filename) : file(filename)
+    {
+        if (!file.isOpen()) {
+            std::cout << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        cursor = file.Data;
+    }
+
+    bool isOpen() const override {
+        return file.isOpen();
+    }
+
+    // text has no header, so guess from the file size like readVerticesMapped
+    uint64_t capacityHint() const override {
+        return file.Size / 24;
+    }
+
+    // the text is parsed a window at a time with parseVerticesParallel, and the blocks
+    // are handed out of the parsed window. windows double up to TEXT_WINDOW_BYTES
+    size_t read(std::vector<glm::vec3>& block, size_t maxPoints = READ_BLOCK_POINTS) override {
+        block.clear();
+        if (!isOpen())
+            return 0;
+        const char* end = file.Data + file.Size;
+        while (next == parsed.size() && cursor < end) {
+            const char* windowEnd = cursor + std::min<size_t>(window, end - cursor);
+            window = std::min(window * 2, TEXT_WINDOW_BYTES);
+            while (windowEnd < end && *(windowEnd - 1) != '\n')
+                windowEnd++;
+            parsed.clear();
+            next = 0;
+            parseVerticesParallel(cursor, windowEnd, parsed);
+            cursor = windowEnd;
+        }
+        size_t n = std::min(maxPoints, parsed.size() - next);
+        block.assign(parsed.begin() + next, parsed.begin() + next + n);
+        next += n;
+        return n;
+    }
+
+private:
+    MappedFile file;
+    const char* cursor = nullptr;
+    // the window being handed out, up to next
+    std::vector<glm::vec3> parsed;
+    size_t next = 0;
+    size_t window = READ_BLOCK_POINTS * 24;
+};
+
+// .pcld, blocks are plain copies out of the mapping
+class CloudReader : public PointReader
+{
+public:
+    CloudReader(const std::string& filename) : cloud(filename)
+    {
+        Count = cloud.count();
+    }
+
+    bool isOpen() const override {
+        return cloud.isOpen();
+    }
+
+    size_t read(std::vector<glm::vec3>& block, size_t maxPoints = READ_BLOCK_POINTS) override {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(maxPoints, Count - done));
+        block.assign(cloud.Points + done, cloud.Points + done + n);
+        done += n;
+        return n;
+    }
+
+private:
+    CloudFile cloud;
+    uint64_t done = 0;
+};
+
+inline bool isBinaryExport(const std::string& filename)
+{
+    return hasExtension(filename, ".pcd") || hasExtension(filename, ".ply");
+}
+
+// reader picked by extension, text for anything we do not recognise
+inline PointReader* openPointReader(const std::string& filename)
+{
+    if (hasExtension(filename, ".pcd"))
+        return new PCDReader(filename);
+    if (hasExtension(filename, ".ply"))
+        return new PLYReader(filename);
+    if (hasCloudExtension(filename))
+        return new CloudReader(filename);
+    return new TextReader(filename);
+}
+
+// drain a reader block by block into vertices
+inline void readVerticesStreamed(PointReader& reader, std::vector<glm::vec3>& vertices)
+{
+    if (!reader.isOpen())
+        return;
+
+    vertices.reserve(vertices.size() + static_cast<size_t>(reader.capacityHint()));
+    std::vector<glm::vec3> block;
+    while (reader.read(block) > 0)
+        vertices.insert(vertices.end(), block.begin(), block.end());
+}
+
+// whole file into vertices, fastest path per format
+inline void readPointFile(const std::string& filename, std::vector<glm::vec3>& vertices)
+{
+    if (hasCloudExtension(filename)) {
+        readCloudFile(filename, vertices);
+        return;
+    }
+
+    if (isBinaryExport(filename)) {
+        PointReader* reader = openPointReader(filename);
+        readVerticesStreamed(*reader, vertices);
+        delete reader;
+        return;
+    }
+
+    readVerticesParallel(filename, vertices);
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef REBUILD_H
+#define REBUILD_H
+
+#include "../glm/glm/glm.hpp"
+#include "pyramid.h"
+#include "quantized.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// resident set size of this process in bytes, from /proc/self/status. field is
+// "VmRSS:" for the current value or "VmHWM:" for the high-water mark.
+inline size_t residentBytes(const char* field)
+{
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file == nullptr)
+        return 0;
+    char line[256];
+    size_t kb = 0;
+    size_t length = strlen(field);
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (strncmp(line, field, length) == 0) {
+            kb = strtoull(line + length, nullptr, 10);
+            break;
+        }
+    }
+    fclose(file);
+    return kb * 1024;
+}
+
+// rebuilds the voxel pyramid at another voxel size on a worker thread while the
+// renderer keeps drawing the old one. the finished pyramid is handed over whole by
+// poll(), so the swap on the render thread is a pointer exchange.
+class PyramidRebuilder
+{
+public:
+    // of the last finished rebuild: wall time, the pyramid's own size, and how much the
+    // process's resident size grew while it ran (0 if it did not, or can not be read).
+    // the growth is that of the whole process, so it includes whatever the render
+    // thread allocated meanwhile
+    double Seconds = 0.0;
+    size_t StructureBytes = 0;
+    size_t GrowthBytes = 0;
+
+    ~PyramidRebuilder()
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool isBusy() const {
+        return busy;
+    }
+
+    // false while a rebuild is still running
+    bool start(std::shared_ptr<const std::vector<glm::vec3>> points, float voxelSize, unsigned int levels) {
+        if (!begin())
+            return false;
+        worker = std::thread([this, points, voxelSize, levels]() {
+            run(voxelSize, levels, [&points](VoxelPyramid& pyramid) {
+                pyramid.build(*points);
+            });
+        });
+        return true;
+    }
+
+    // same for a quantized cloud, decoded point by point into keys
+    bool start(std::shared_ptr<const QuantizedCloud> cloud, float voxelSize, unsigned int levels) {
+        if (!begin())
+            return false;
+        worker = std::thread([this, cloud, voxelSize, levels]() {
+            run(voxelSize, levels, [&cloud](VoxelPyramid& pyramid) {
+                std::vector<uint64_t> keys;
+                keys.reserve(cloud->size());
+                const MortonVoxelSet& finest = pyramid.level(0);
+                cloud->forEach([&keys, &finest](const glm::vec3& point) {
+                    keys.push_back(finest.keyOf(point));
+                });
+                pyramid.buildFromKeys(keys);
+            });
+        });
+        return true;
+    }
+
+    // the finished pyramid, exactly once; nullptr while the worker is still going
+    std::shared_ptr<VoxelPyramid> poll() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<VoxelPyramid> finished;
+        finished.swap(result);
+        return finished;
+    }
+
+private:
+    std::thread worker;
+    std::atomic<bool> busy{ false };
+    std::mutex mutex;
+    std::shared_ptr<VoxelPyramid> result;
+
+    bool begin() {
+        if (busy)
+            return false;
+        if (worker.joinable())
+            worker.join();
+        busy = true;
+        return true;
+    }
+
+    template <typename F>
+    void run(float voxelSize, unsigned int levels, F build) {
+        size_t before = residentBytes("VmRSS:");
+        auto t0 = std::chrono::steady_clock::now();
+
+        std::shared_ptr<VoxelPyramid> pyramid = std::make_shared<VoxelPyramid>(voxelSize, levels);
+        build(*pyramid);
+
+        auto t1 = std::chrono::steady_clock::now();
+        size_t after = residentBytes("VmRSS:");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Seconds = std::chrono::duration<double>(t1 - t0).count();
+            StructureBytes = pyramid->memoryBytes();
+            GrowthBytes = after > before ? after - before : 0;
+            result = pyramid;
+        }
+        busy = false;
+    }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// lock-free single-producer/single-consumer ring.
+// exactly one thread may push and exactly one other thread may pop. each side owns one
+// index and only reads the other, so acquire/release ordering is all that is needed.
+template <typename T>
+class SPSCRing
+{
+public:
+    // capacity is rounded up to a power of two
+    SPSCRing(size_t capacity = 1 << 20)
+    {
+        size_t n = 1;
+        while (n < capacity)
+            n <<= 1;
+        buffer.resize(n);
+        mask = n - 1;
+    }
+
+    size_t capacity() const {
+        return buffer.size();
+    }
+
+    // producer: copy up to count items in, returns how many fit
+    size_t push(const T* items, size_t count) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t n = std::min(count, buffer.size() - (h - t));
+        for (size_t i = 0; i < n; i++)
+            buffer[(h + i) & mask] = items[i];
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer: copy up to count items out, returns how many were available
+    size_t pop(T* items, size_t count) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t n = std::min(count, h - t);
+        for (size_t i = 0; i < n; i++)
+            items[i] = buffer[(t + i) & mask];
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer: append up to count items to out, returns how many were available. the
+    // items are inserted straight from the ring, in at most two runs
+    size_t pop(std::vector<T>& out, size_t count) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t n = std::min(count, h - t);
+        size_t first = t & mask;
+        size_t run = std::min(n, buffer.size() - first);
+        out.insert(out.end(), buffer.begin() + first, buffer.begin() + first + run);
+        out.insert(out.end(), buffer.begin(), buffer.begin() + (n - run));
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer side estimate, may be stale by the time it is used
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> buffer;
+    size_t mask;
+    // producer and consumer indices on separate cache lines so they do not false-share.
+    // padded rather than alignas(64), which plain new does not honour before C++17.
+    char padBefore[64];
+    std::atomic<size_t> head{ 0 };
+    char padBetween[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail{ 0 };
+    char padAfter[64 - sizeof(std::atomic<size_t>)];
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SLABCACHE_H
+#define SLABCACHE_H
+
+#include "../glm/glm/glm.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// voxels of the horizontal slab the camera is in, kept between frames. the slab is
+// quantized to the voxel lattice: with voxel centres at (k + 0.5) * voxelSize, slab k
+// is the two layers whose centres bracket the camera, so it only changes when the camera
+// crosses a layer centre. the voxels are queried again only when the slab index or the
+// version of the structure behind them changes.
+class SlabCache
+{
+public:
+    // slab of height y on a lattice of voxelSize
+    static int64_t slabOf(float y, float voxelSize) {
+        return static_cast<int64_t>(std::floor(static_cast<double>(y) / voxelSize - 0.5));
+    }
+
+    // centre heights of the two layers of slab
+    static void slabBounds(int64_t slab, float voxelSize, float& yMin, float& yMax) {
+        yMin = static_cast<float>((slab + 0.5) * voxelSize);
+        yMax = static_cast<float>((slab + 1.5) * voxelSize);
+    }
+
+    // query(yMin, yMax, voxels) fills the empty vector unless the voxels cached are
+    // those of y's slab under version; returns true if it ran
+    template <typename F>
+    bool update(float y, float voxelSize, uint64_t version, F query) {
+        int64_t slab = slabOf(y, voxelSize);
+        if (valid && slab == Slab && voxelSize == VoxelSize && version == Version)
+            return false;
+        float yMin, yMax;
+        slabBounds(slab, voxelSize, yMin, yMax);
+        Voxels.clear();
+        query(yMin, yMax, Voxels);
+        Slab = slab;
+        VoxelSize = voxelSize;
+        Version = version;
+        valid = true;
+        return true;
+    }
+
+    const std::vector<glm::vec3>& voxels() const {
+        return Voxels;
+    }
+
+private:
+    std::vector<glm::vec3> Voxels;
+    int64_t Slab = 0;
+    float VoxelSize = 0.0f;
+    uint64_t Version = 0;
+    bool valid = false;
+};
+
+#endif
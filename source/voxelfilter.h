@@ -0,0 +1,114 @@
+#ifndef VOXELFILTER_H
+#define VOXELFILTER_H
+
+#include "../glm/glm/glm.hpp"
+#include "hashgrid.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// voxel grid filter that keeps what the points in a voxel looked like instead of snapping
+// them to the lattice: centroid, point count and height range, gathered in one pass.
+// accumulators are structure-of-arrays indexed like the hash grid's Voxels, and sums are
+// taken relative to the voxel centre so float stays exact enough for millions of points.
+class CentroidVoxelFilter
+{
+public:
+    std::vector<float> SumX;
+    std::vector<float> SumY;
+    std::vector<float> SumZ;
+    std::vector<uint32_t> Counts;
+    std::vector<float> MinY;
+    std::vector<float> MaxY;
+
+    CentroidVoxelFilter(float voxelSize = 1.0f, size_t expected = 1024) : grid(voxelSize, expected) {}
+
+    float getVoxelSize() const {
+        return grid.getVoxelSize();
+    }
+
+    size_t size() const {
+        return Counts.size();
+    }
+
+    void clear() {
+        grid.clear();
+        SumX.clear();
+        SumY.clear();
+        SumZ.clear();
+        Counts.clear();
+        MinY.clear();
+        MaxY.clear();
+    }
+
+    // returns true if the point opened a new voxel
+    bool insert(const glm::vec3& point) {
+        return accumulate(grid.keyOf(point), point);
+    }
+
+    void insert(const glm::vec3* points, size_t count) {
+        uint64_t keys[HASHGRID_BATCH];
+        for (size_t first = 0; first < count; first += HASHGRID_BATCH) {
+            size_t n = std::min(HASHGRID_BATCH, count - first);
+            encodeVoxelKeys(points + first, n, grid.getVoxelSize(), keys);
+            for (size_t i = 0; i < n; i++)
+                accumulate(keys[i], points[first + i]);
+        }
+    }
+
+    const glm::vec3& centreOf(size_t i) const {
+        return grid.Voxels[i];
+    }
+
+    glm::vec3 centroidOf(size_t i) const {
+        float inv = 1.0f / static_cast<float>(Counts[i]);
+        return grid.Voxels[i] + glm::vec3(SumX[i], SumY[i], SumZ[i]) * inv;
+    }
+
+    // centroids of the voxels backed by at least minCount points, in first-seen order
+    void centroids(std::vector<glm::vec3>& out, uint32_t minCount = 1) const {
+        for (size_t i = 0; i < Counts.size(); i++) {
+            if (Counts[i] >= minCount)
+                out.push_back(centroidOf(i));
+        }
+    }
+
+    // centroids in the camera's slab, same test the other backends use on voxel centres
+    void findByY(float y, std::vector<glm::vec3>& points, uint32_t minCount = 1) const {
+        const float voxelSize = grid.getVoxelSize();
+        for (size_t i = 0; i < Counts.size(); i++) {
+            const glm::vec3& c = grid.Voxels[i];
+            if (Counts[i] >= minCount && y >= c.y - voxelSize && y <= c.y + voxelSize)
+                points.push_back(centroidOf(i));
+        }
+    }
+
+private:
+    VoxelHashGrid grid;
+
+    bool accumulate(uint64_t key, const glm::vec3& point) {
+        bool inserted;
+        size_t i = grid.indexOfKey(key, inserted);
+        if (inserted) {
+            SumX.push_back(0.0f);
+            SumY.push_back(0.0f);
+            SumZ.push_back(0.0f);
+            Counts.push_back(0);
+            MinY.push_back(point.y);
+            MaxY.push_back(point.y);
+        }
+        const glm::vec3& c = grid.Voxels[i];
+        SumX[i] += point.x - c.x;
+        SumY[i] += point.y - c.y;
+        SumZ[i] += point.z - c.z;
+        Counts[i]++;
+        if (point.y < MinY[i])
+            MinY[i] = point.y;
+        if (point.y > MaxY[i])
+            MaxY[i] = point.y;
+        return inserted;
+    }
+};
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef VOXELKEY_H
+#define VOXELKEY_H
+
+#include "../glm/glm/glm.hpp"
+#include "morton.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VOXELKEY_X86 1
+#endif
+
+// voxel index packed into one 64-bit word: every axis is biased by 2^20 into 21 unsigned
+// bits, x in the high field and z in the low one, so negative coordinates never spill
+// into the neighbouring field. the batch codecs below turn whole point arrays into keys
+// (and keys back into voxel centres) 8 at a time with AVX2 when the CPU has it,
+// picked at run time so the same binary still runs on older machines.
+
+const int VOXELKEY_BIAS = 1 << 20;
+const uint64_t VOXELKEY_MASK = (1ull << 21) - 1;
+
+struct VoxelKey
+{
+    uint64_t Value;
+
+    VoxelKey() : Value(0) {}
+    explicit VoxelKey(uint64_t value) : Value(value) {}
+    VoxelKey(int x, int y, int z) : Value(pack(x, y, z)) {}
+
+    static uint64_t pack(int x, int y, int z) {
+        return (static_cast<uint64_t>((x + VOXELKEY_BIAS) & VOXELKEY_MASK) << 42) |
+            (static_cast<uint64_t>((y + VOXELKEY_BIAS) & VOXELKEY_MASK) << 21) |
+            static_cast<uint64_t>((z + VOXELKEY_BIAS) & VOXELKEY_MASK);
+    }
+
+    static VoxelKey fromPoint(const glm::vec3& point, float voxelSize) {
+        glm::vec3 f = glm::floor(point / voxelSize);
+        return VoxelKey(static_cast<int>(f.x), static_cast<int>(f.y), static_cast<int>(f.z));
+    }
+
+    int x() const {
+        return static_cast<int>((Value >> 42) & VOXELKEY_MASK) - VOXELKEY_BIAS;
+    }
+    int y() const {
+        return static_cast<int>((Value >> 21) & VOXELKEY_MASK) - VOXELKEY_BIAS;
+    }
+    int z() const {
+        return static_cast<int>(Value & VOXELKEY_MASK) - VOXELKEY_BIAS;
+    }
+
+    glm::vec3 centre(float voxelSize) const {
+        return (glm::vec3(x(), y(), z()) + 0.5f) * voxelSize;
+    }
+
+    // same voxel as a Morton key, see morton.h
+    uint64_t morton() const {
+        return mortonEncode(x(), y(), z());
+    }
+
+    bool operator==(const VoxelKey& other) const {
+        return Value == other.Value;
+    }
+    bool operator!=(const VoxelKey& other) const {
+        return Value != other.Value;
+    }
+    bool operator<(const VoxelKey& other) const {
+        return Value < other.Value;
+    }
+};
+
+// true when the AVX2 + BMI2 batch paths can run on this CPU
+inline bool hasVectorCodec()
+{
+#if defined(VOXELKEY_X86)
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#if defined(VOXELKEY_X86)
+// 8 points -> biased voxel indices per axis, with the same divide and floor as the
+// scalar path so both agree on points lying exactly on a voxel face
+__attribute__((target("avx2"))) inline void voxelIndices8(const glm::vec3* points, __m256 size, __m256i& ix, __m256i& iy, __m256i& iz)
+{
+    const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i bias = _mm256_set1_epi32(VOXELKEY_BIAS);
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(VOXELKEY_MASK));
+    const float* base = &points[0].x;
+    __m256 x = _mm256_i32gather_ps(base, stride, 4);
+    __m256 y = _mm256_i32gather_ps(base + 1, stride, 4);
+    __m256 z = _mm256_i32gather_ps(base + 2, stride, 4);
+    ix = _mm256_and_si256(_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(x, size))), bias), mask);
+    iy = _mm256_and_si256(_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(y, size))), bias), mask);
+    iz = _mm256_and_si256(_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(z, size))), bias), mask);
+}
+
+__attribute__((target("avx2"))) inline void encodeVoxelKeysAVX2(const glm::vec3* points, size_t count, float voxelSize, uint64_t* keys)
+{
+    const __m256 size = _mm256_set1_ps(voxelSize);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i ix, iy, iz;
+        voxelIndices8(points + i, size, ix, iy, iz);
+        for (int half = 0; half < 2; half++) {
+            __m128i x = half ? _mm256_extracti128_si256(ix, 1) : _mm256_castsi256_si128(ix);
+            __m128i y = half ? _mm256_extracti128_si256(iy, 1) : _mm256_castsi256_si128(iy);
+            __m128i z = half ? _mm256_extracti128_si256(iz, 1) : _mm256_castsi256_si128(iz);
+            __m256i key = _mm256_or_si256(_mm256_or_si256(
+                _mm256_slli_epi64(_mm256_cvtepu32_epi64(x), 42),
+                _mm256_slli_epi64(_mm256_cvtepu32_epi64(y), 21)),
+                _mm256_cvtepu32_epi64(z));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(keys + i + half * 4), key);
+        }
+    }
+    for (; i < count; i++)
+        keys[i] = VoxelKey::fromPoint(points[i], voxelSize).Value;
+}
+
+__attribute__((target("avx2,bmi2"))) inline void encodeMortonKeysAVX2(const glm::vec3* points, size_t count, float voxelSize, uint64_t* keys)
+{
+    const __m256 size = _mm256_set1_ps(voxelSize);
+    alignas(32) uint32_t x[8], y[8], z[8];
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i ix, iy, iz;
+        voxelIndices8(points + i, size, ix, iy, iz);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(x), ix);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(y), iy);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(z), iz);
+        for (int k = 0; k < 8; k++) {
+            keys[i + k] = _pdep_u64(x[k], MORTON_X_BITS) | _pdep_u64(y[k], MORTON_X_BITS << 1) |
+                _pdep_u64(z[k], MORTON_X_BITS << 2);
+        }
+    }
+    for (; i < count; i++)
+        keys[i] = VoxelKey::fromPoint(points[i], voxelSize).morton();
+}
+
+// biased indices of 8 lanes -> centres, written back as packed vec3
+__attribute__((target("avx2"))) inline void storeCentres8(__m256i ix, __m256i iy, __m256i iz, int indexBias, float voxelSize, glm::vec3* centres)
+{
+    const __m256i bias = _mm256_set1_epi32(indexBias);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 size = _mm256_set1_ps(voxelSize);
+    alignas(32) float x[8], y[8], z[8];
+    _mm256_store_ps(x, _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(ix, bias)), half), size));
+    _mm256_store_ps(y, _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(iy, bias)), half), size));
+    _mm256_store_ps(z, _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(iz, bias)), half), size));
+    for (int k = 0; k < 8; k++)
+        centres[k] = glm::vec3(x[k], y[k], z[k]);
+}
+
+// low dword of every 64-bit lane of lo and hi, in order
+__attribute__((target("avx2"))) inline __m256i narrow8(__m256i lo, __m256i hi)
+{
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    return _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(lo, even), _mm256_permutevar8x32_epi32(hi, even), 0x20);
+}
+
+__attribute__((target("avx2"))) inline void decodeVoxelKeysAVX2(const uint64_t* keys, size_t count, float voxelSize, glm::vec3* centres)
+{
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(VOXELKEY_MASK));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i + 4));
+        __m256i ix = narrow8(_mm256_srli_epi64(lo, 42), _mm256_srli_epi64(hi, 42));
+        __m256i iy = narrow8(_mm256_and_si256(_mm256_srli_epi64(lo, 21), mask), _mm256_and_si256(_mm256_srli_epi64(hi, 21), mask));
+        __m256i iz = narrow8(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask));
+        storeCentres8(ix, iy, iz, VOXELKEY_BIAS, voxelSize, centres + i);
+    }
+    for (; i < count; i++)
+        centres[i] = VoxelKey(keys[i]).centre(voxelSize);
+}
+
+__attribute__((target("avx2,bmi2"))) inline void decodeMortonKeysAVX2(const uint64_t* keys, size_t count, float voxelSize, glm::vec3* centres, int bias)
+{
+    alignas(32) uint32_t x[8], y[8], z[8];
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int k = 0; k < 8; k++) {
+            x[k] = static_cast<uint32_t>(_pext_u64(keys[i + k], MORTON_X_BITS));
+            y[k] = static_cast<uint32_t>(_pext_u64(keys[i + k], MORTON_X_BITS << 1));
+            z[k] = static_cast<uint32_t>(_pext_u64(keys[i + k], MORTON_X_BITS << 2));
+        }
+        storeCentres8(_mm256_load_si256(reinterpret_cast<const __m256i*>(x)),
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(y)),
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(z)), bias, voxelSize, centres + i);
+    }
+    for (; i < count; i++) {
+        int vx, vy, vz;
+        mortonDecode(keys[i], vx, vy, vz, bias);
+        centres[i] = (glm::vec3(vx, vy, vz) + 0.5f) * voxelSize;
+    }
+}
+#endif
+
+// points -> packed voxel keys
+inline void encodeVoxelKeys(const glm::vec3* points, size_t count, float voxelSize, uint64_t* keys)
+{
+#if defined(VOXELKEY_X86)
+    if (hasVectorCodec()) {
+        encodeVoxelKeysAVX2(points, count, voxelSize, keys);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++)
+        keys[i] = VoxelKey::fromPoint(points[i], voxelSize).Value;
+}
+
+// points -> Morton keys of their voxels
+inline void encodeMortonKeys(const glm::vec3* points, size_t count, float voxelSize, uint64_t* keys)
+{
+#if defined(VOXELKEY_X86)
+    if (hasVectorCodec()) {
+        encodeMortonKeysAVX2(points, count, voxelSize, keys);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++)
+        keys[i] = VoxelKey::fromPoint(points[i], voxelSize).morton();
+}
+
+// packed voxel keys -> voxel centres
+inline void decodeVoxelKeys(const uint64_t* keys, size_t count, float voxelSize, glm::vec3* centres)
+{
+#if defined(VOXELKEY_X86)
+    if (hasVectorCodec()) {
+        decodeVoxelKeysAVX2(keys, count, voxelSize, centres);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++)
+        centres[i] = VoxelKey(keys[i]).centre(voxelSize);
+}
+
+// Morton keys -> voxel centres, bias as in mortonDecode
+inline void decodeMortonKeys(const uint64_t* keys, size_t count, float voxelSize, glm::vec3* centres, int bias = MORTON_BIAS)
+{
+#if defined(VOXELKEY_X86)
+    if (hasVectorCodec()) {
+        decodeMortonKeysAVX2(keys, count, voxelSize, centres, bias);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++) {
+        int x, y, z;
+        mortonDecode(keys[i], x, y, z, bias);
+        centres[i] = (glm::vec3(x, y, z) + 0.5f) * voxelSize;
+    }
+}
+
+#endif
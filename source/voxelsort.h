@@ -0,0 +1,247 @@
+#ifndef VOXELSORT_H
+#define VOXELSORT_H
+
+#include "../glm/glm/glm.hpp"
+#include "hashgrid.h"
+#include "morton.h"
+#include "voxelkey.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// parallel LSD radix sort of 64-bit keys, 8 bits per pass. each thread histograms and
+// scatters its own fixed slice, and slices are laid out thread by thread inside every
+// bucket, so the sort is stable and the result never depends on the thread count.
+// passes whose digit is the same for every key are skipped.
+inline void radixSort(std::vector<uint64_t>& keys, unsigned int threads = 0)
+{
+    const size_t n = keys.size();
+    if (n < 2)
+        return;
+    if (threads == 0)
+        threads = workerCount();
+    // below this the thread start-up costs more than the sort
+    if (n < (1 << 16))
+        threads = 1;
+
+    std::vector<uint64_t> scratch(n);
+    std::vector<size_t> histogram(threads * 256);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        std::fill(histogram.begin(), histogram.end(), 0);
+        parallelFor(n, threads, [&](unsigned int t, size_t begin, size_t end) {
+            size_t* h = &histogram[t * 256];
+            for (size_t i = begin; i < end; i++)
+                h[(keys[i] >> shift) & 0xff]++;
+        });
+
+        // bucket-major, thread-minor exclusive prefix sum
+        size_t total = 0;
+        bool trivial = false;
+        for (int d = 0; d < 256; d++) {
+            size_t bucket = 0;
+            for (unsigned int t = 0; t < threads; t++) {
+                size_t c = histogram[t * 256 + d];
+                histogram[t * 256 + d] = total;
+                total += c;
+                bucket += c;
+            }
+            if (bucket == n)
+                trivial = true;
+        }
+        if (trivial)
+            continue;
+
+        parallelFor(n, threads, [&](unsigned int t, size_t begin, size_t end) {
+            size_t* offset = &histogram[t * 256];
+            for (size_t i = begin; i < end; i++)
+                scratch[offset[(keys[i] >> shift) & 0xff]++] = keys[i];
+        });
+        keys.swap(scratch);
+    }
+}
+
+// voxel grid built by sorting instead of hashing: one Morton key per point, radix sort,
+// then every run of equal keys is one voxel. all passes stream through memory, and the
+// voxels come out in Morton order, identical for any thread count.
+class MortonVoxelSet
+{
+public:
+    // sorted, unique voxel keys and their centres, index for index
+    std::vector<uint64_t> Keys;
+    std::vector<glm::vec3> Voxels;
+
+    MortonVoxelSet(float voxelSize = 1.0f)
+    {
+        VoxelSize = voxelSize;
+        Level = 0;
+    }
+
+    float getVoxelSize() const {
+        return VoxelSize;
+    }
+
+    // bytes held on the CPU
+    size_t memoryBytes() const {
+        return Keys.capacity() * sizeof(uint64_t) + Voxels.capacity() * sizeof(glm::vec3);
+    }
+
+    // how many times this set was coarsened, see coarsen()
+    unsigned int getLevel() const {
+        return Level;
+    }
+
+    size_t size() const {
+        return Keys.size();
+    }
+
+    uint64_t keyOf(const glm::vec3& point) const {
+        glm::vec3 f = glm::floor(point / VoxelSize);
+        return mortonEncode(static_cast<int>(f.x), static_cast<int>(f.y), static_cast<int>(f.z), bias());
+    }
+
+    glm::vec3 centreOf(uint64_t key) const {
+        int x, y, z;
+        mortonDecode(key, x, y, z, bias());
+        return (glm::vec3(x, y, z) + 0.5f) * VoxelSize;
+    }
+
+    void build(const glm::vec3* points, size_t count, unsigned int threads = 0) {
+        Level = 0;
+        std::vector<uint64_t> keys(count);
+        parallelFor(count, threads, [&](unsigned int, size_t begin, size_t end) {
+            encodeMortonKeys(points + begin, end - begin, VoxelSize, keys.data() + begin);
+        });
+        buildFromKeys(keys, threads);
+    }
+
+    void build(const std::vector<glm::vec3>& points, unsigned int threads = 0) {
+        build(points.data(), points.size(), threads);
+    }
+
+    // unsorted per-point keys in, voxels out; keys is sorted in place
+    void buildFromKeys(std::vector<uint64_t>& keys, unsigned int threads = 0) {
+        radixSort(keys, threads);
+
+        Keys.clear();
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i == 0 || keys[i] != keys[i - 1])
+                Keys.push_back(keys[i]);
+        }
+        decodeVoxels(threads);
+    }
+
+    // the set at twice the voxel size of finer, without touching a single point: the parent
+    // key is the child key shifted right by one triple, and since that keeps the order the
+    // unique pass is all the merging there is
+    void coarsen(const MortonVoxelSet& finer, unsigned int threads = 0) {
+        VoxelSize = finer.VoxelSize * 2.0f;
+        Level = finer.Level + 1;
+
+        Keys.clear();
+        for (size_t i = 0; i < finer.Keys.size(); i++) {
+            uint64_t key = finer.Keys[i] >> 3;
+            if (Keys.empty() || Keys.back() != key)
+                Keys.push_back(key);
+        }
+        decodeVoxels(threads);
+    }
+
+    // voxels whose slab contains y, same test findByY does at leaf level
+    void findByY(float y, std::vector<glm::vec3>& points) const {
+        for (const auto& v : Voxels) {
+            if (y >= v.y - VoxelSize && y <= v.y + VoxelSize)
+                points.push_back(v);
+        }
+    }
+
+private:
+    float VoxelSize;
+    unsigned int Level;
+
+    // coarser sets span a smaller index range, with the bias halved per level
+    int bias() const {
+        return MORTON_BIAS >> Level;
+    }
+
+    void decodeVoxels(unsigned int threads) {
+        Voxels.resize(Keys.size());
+        parallelFor(Keys.size(), threads, [&](unsigned int, size_t begin, size_t end) {
+            decodeMortonKeys(Keys.data() + begin, end - begin, VoxelSize, Voxels.data() + begin, bias());
+        });
+    }
+};
+
+// voxel grid built on all cores: every thread collapses its own slice of the input into
+// a partial hash set, then the partial key lists are concatenated and radix sorted, which
+// merges them by key range. the voxels come out sorted by VoxelKey, so the result is the
+// same for any thread count.
+class ParallelVoxelGrid
+{
+public:
+    // sorted, unique VoxelKey values and their centres, index for index
+    std::vector<uint64_t> Keys;
+    std::vector<glm::vec3> Voxels;
+
+    ParallelVoxelGrid(float voxelSize = 1.0f)
+    {
+        VoxelSize = voxelSize;
+    }
+
+    float getVoxelSize() const {
+        return VoxelSize;
+    }
+
+    size_t size() const {
+        return Keys.size();
+    }
+
+    void build(const glm::vec3* points, size_t count, unsigned int threads = 0) {
+        if (threads == 0)
+            threads = workerCount();
+        threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+
+        std::vector<std::vector<uint64_t>> partial(threads);
+        parallelFor(count, threads, [&](unsigned int t, size_t begin, size_t end) {
+            VoxelHashGrid grid(VoxelSize, (end - begin) / 4);
+            grid.insert(points + begin, end - begin);
+            grid.keys(partial[t]);
+        });
+
+        std::vector<size_t> offsets(threads + 1, 0);
+        for (unsigned int t = 0; t < threads; t++)
+            offsets[t + 1] = offsets[t] + partial[t].size();
+        std::vector<uint64_t> keys(offsets[threads]);
+        parallelFor(threads, threads, [&](unsigned int, size_t begin, size_t end) {
+            for (size_t t = begin; t < end; t++) {
+                std::copy(partial[t].begin(), partial[t].end(), keys.begin() + offsets[t]);
+                std::vector<uint64_t>().swap(partial[t]);
+            }
+        });
+
+        // a voxel seen by several threads shows up once per thread, the sort lines them up
+        radixSort(keys, threads);
+        Keys.clear();
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i == 0 || keys[i] != keys[i - 1])
+                Keys.push_back(keys[i]);
+        }
+
+        Voxels.resize(Keys.size());
+        parallelFor(Keys.size(), threads, [&](unsigned int, size_t begin, size_t end) {
+            decodeVoxelKeys(Keys.data() + begin, end - begin, VoxelSize, Voxels.data() + begin);
+        });
+    }
+
+    void build(const std::vector<glm::vec3>& points, unsigned int threads = 0) {
+        build(points.data(), points.size(), threads);
+    }
+
+private:
+    float VoxelSize;
+};
+
+#endif